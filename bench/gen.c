@@ -0,0 +1,164 @@
+/* gen.c - synthetic roster generator for the SRMS benchmarks
+ *
+ * Writes a student CSV in the students.csv layout, a batch spec with
+ * course-tagged batches sized to the intake, and ranked preferences:
+ *
+ *   gen STUDENTS BATCHES OUT_PREFIX [SEED]
+ *     -> OUT_PREFIX.students.csv, OUT_PREFIX.batches.csv, OUT_PREFIX.prefs.csv
+ *
+ * Names are drawn from common first/last names, marks are roughly normal
+ * around a per-course mean, courses follow a fixed enrolment mix, and
+ * preferences favour a few popular batches of the student's own course.
+ * Output depends only on the arguments.
+ *
+ * Compile: gcc -std=c11 -O2 -Wall -o bench/gen bench/gen.c
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *first_names[] = {
+    "Aarav", "Aditya", "Aisha", "Ananya", "Arjun", "Diya", "Ishaan", "Kavya", "Krishna", "Meera",
+    "Mohammed", "Neha", "Nikhil", "Pooja", "Priya", "Rahul", "Riya", "Rohan", "Saanvi", "Sahil",
+    "Sanjana", "Shreya", "Siddharth", "Sneha", "Tanya", "Varun", "Vihaan", "Yash", "Zara", "Kabir",
+    "Aryan", "Ishita", "Manav", "Nandini", "Om", "Pranav", "Ritika", "Tanvi", "Uday", "Vanya"
+};
+static const char *last_names[] = {
+    "Sharma", "Verma", "Gupta", "Singh", "Kumar", "Jaiswal", "Sinha", "Patel", "Reddy", "Nair",
+    "Iyer", "Das", "Chopra", "Mehta", "Joshi", "Bhat", "Rao", "Kapoor", "Malhotra", "Agarwal",
+    "Pandey", "Mishra", "Chauhan", "Yadav", "Thakur", "Saxena", "Bose", "Ghosh", "Menon", "Pillai"
+};
+
+typedef struct {
+    const char *name;
+    int weight;   /* share of the intake */
+    int mean;     /* mean marks */
+} Course;
+
+static const Course courses[] = {
+    { "CSE", 40, 72 }, { "ECE", 15, 68 }, { "ME", 10, 64 }, { "CIVIL", 8, 62 },
+    { "EEE", 7, 66 }, { "BBA", 10, 70 }, { "BDES", 5, 74 }, { "LAW", 5, 69 }
+};
+#define NCOURSES ((int)(sizeof courses / sizeof courses[0]))
+#define COUNT(a) ((int)(sizeof a / sizeof a[0]))
+
+static uint64_t rng_state;
+
+/* splitmix64 */
+static uint64_t next_u64(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static int uniform(int n) { return (int)(next_u64() % (uint64_t)n); }
+
+/* Approximately normal (Irwin-Hall, 12 uniforms), in hundredths */
+static int normal_hundredths(int mean, int sd) {
+    double s = 0;
+    for (int i = 0; i < 12; ++i) s += (double)(next_u64() >> 11) / 9007199254740992.0;
+    long v = (long)((mean + (s - 6.0) * sd) * 100.0);
+    return v < 0 ? 0 : v > 10000 ? 10000 : (int)v;
+}
+
+static int pick_course(void) {
+    int total = 0;
+    for (int c = 0; c < NCOURSES; ++c) total += courses[c].weight;
+    int r = uniform(total);
+    for (int c = 0; c < NCOURSES; ++c) {
+        if (r < courses[c].weight) return c;
+        r -= courses[c].weight;
+    }
+    return 0;
+}
+
+/* Index in [0, n) skewed towards 0: a few batches are popular */
+static int skewed(int n) {
+    int a = uniform(n), b = uniform(n);
+    return a < b ? a : b;
+}
+
+static FILE *open_out(const char *prefix, const char *suffix) {
+    char path[4096];
+    snprintf(path, sizeof path, "%s.%s", prefix, suffix);
+    FILE *f = fopen(path, "w");
+    if (!f) fprintf(stderr, "gen: cannot write %s\n", path);
+    return f;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: gen STUDENTS BATCHES OUT_PREFIX [SEED]\n");
+        return 1;
+    }
+    long n = strtol(argv[1], NULL, 10), nb = strtol(argv[2], NULL, 10);
+    if (n <= 0 || n > 100000000 || nb < NCOURSES) {
+        fprintf(stderr, "gen: need 1..100000000 students and at least %d batches\n", NCOURSES);
+        return 1;
+    }
+    rng_state = argc > 4 ? strtoull(argv[4], NULL, 10) : 42;
+
+    int *course_of = malloc(sizeof(int) * (size_t)n);
+    if (!course_of) { fprintf(stderr, "gen: out of memory\n"); return 1; }
+    long enrolled[NCOURSES] = {0};
+    for (long i = 0; i < n; ++i) enrolled[course_of[i] = pick_course()]++;
+
+    /* Batches per course in proportion to enrolment (at least one each),
+     * with 5% spare capacity */
+    long per_course[NCOURSES], first[NCOURSES], assigned = 0;
+    for (int c = 0; c < NCOURSES; ++c) {
+        per_course[c] = 1 + (nb - NCOURSES) * enrolled[c] / n;
+        assigned += per_course[c];
+    }
+    for (int c = 0; assigned < nb; c = (c + 1) % NCOURSES, ++assigned) per_course[c]++;
+
+    FILE *sf = open_out(argv[3], "students.csv");
+    FILE *bf = open_out(argv[3], "batches.csv");
+    FILE *pf = open_out(argv[3], "prefs.csv");
+    if (!sf || !bf || !pf) return 1;
+
+    fprintf(bf, "name,capacity,course\n");
+    long next = 0;
+    for (int c = 0; c < NCOURSES; ++c) {
+        first[c] = next;
+        long cap = (enrolled[c] * 105 / 100 + per_course[c] - 1) / per_course[c];
+        if (cap < 1) cap = 1;
+        for (long b = 0; b < per_course[c]; ++b) fprintf(bf, "%s-%03ld,%ld,%s\n", courses[c].name, b + 1, cap, courses[c].name);
+        next += per_course[c];
+    }
+
+    fprintf(sf, "roll,name,marks,course,batch\n");
+    fprintf(pf, "sap,choice1,choice2,choice3\n");
+    for (long i = 0; i < n; ++i) {
+        int c = course_of[i];
+        /* a bijection on [0, 1e8), so roll numbers never repeat */
+        long roll = 500000000 + (long)(((uint64_t)i * 2654435761u + 12345) % 100000000u);
+        int marks = normal_hundredths(courses[c].mean, 14);
+        fprintf(sf, "%ld,%s %s,%d.%02d,%s,\n", roll, first_names[uniform(COUNT(first_names))],
+                last_names[uniform(COUNT(last_names))], marks / 100, marks % 100, courses[c].name);
+
+        /* 3-8 distinct choices, mostly within the student's own course */
+        int k = 3 + uniform(6);
+        long chosen[8];
+        int got = 0;
+        fprintf(pf, "%ld", roll);
+        for (int tries = 0; got < k && tries < 64; ++tries) {
+            int oc = uniform(10) < 8 ? c : uniform(NCOURSES);
+            long b = first[oc] + skewed((int)per_course[oc]);
+            int dup = 0;
+            for (int j = 0; j < got; ++j) dup |= chosen[j] == b;
+            if (dup) continue;
+            chosen[got++] = b;
+            fprintf(pf, ",%s-%03ld", courses[oc].name, b - first[oc] + 1);
+        }
+        fputc('\n', pf);
+    }
+    free(course_of);
+    int bad = ferror(sf) | ferror(bf) | ferror(pf);
+    bad |= fclose(sf) | fclose(bf) | fclose(pf);
+    if (bad) { fprintf(stderr, "gen: write error\n"); return 1; }
+    return 0;
+}
@@ -0,0 +1,271 @@
+/* loadgen.c - load generator for `srms serve`
+ *
+ * Opens CONNECTIONS connections to the server's Unix socket, each on its
+ * own thread, and sends GET requests for SAPs picked at random from a
+ * student CSV (first column), one at a time, for SECONDS seconds. Prints
+ * one JSON object with the query rate and latency percentiles:
+ *
+ *   loadgen SOCKET STUDENTS_CSV [CONNECTIONS] [SECONDS] [ROSTER_EVERY] [REALLOCATE_MS]
+ *
+ * With ROSTER_EVERY = n, every n-th request of a connection asks for the
+ * roster of the batch the previous student was in instead. With
+ * REALLOCATE_MS = m, one more connection re-runs the allocation (marks and
+ * balanced in turn) every m milliseconds, to measure lookups while the
+ * server publishes new results.
+ *
+ * Compile: gcc -std=c11 -O2 -Wall -pthread -o bench/loadgen bench/loadgen.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_CONNECTIONS 1024
+
+typedef struct {
+    int id;
+    const char *sock;
+    double deadline;
+    int roster_every;
+    int reallocate_ms;  /* admin connection: reallocation period, else 0 */
+    uint64_t *lat_ns;   /* one entry per completed request */
+    size_t n, cap;
+    long not_found, errors;
+} Worker;
+
+static char **saps;
+static size_t nsaps;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int load_saps(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[1024];
+    size_t cap = 0;
+    int first = 1;
+    while (fgets(line, sizeof line, f)) {
+        if (first) { first = 0; continue; } /* header */
+        size_t n = strcspn(line, ",\r\n");
+        if (n == 0) continue;
+        if (nsaps == cap) {
+            cap = cap ? cap * 2 : 1024;
+            char **tmp = realloc(saps, sizeof(char *) * cap);
+            if (!tmp) { fclose(f); return -1; }
+            saps = tmp;
+        }
+        line[n] = '\0';
+        if (!(saps[nsaps++] = strdup(line))) { fclose(f); return -1; }
+    }
+    fclose(f);
+    return nsaps > 0 ? 0 : -1;
+}
+
+/* Read one reply: a line, plus n more for "OK n" roster replies */
+static int read_reply(int fd, char *buf, size_t cap, size_t *have, int roster, char *first, size_t first_cap) {
+    long lines_left = -1;
+    for (;;) {
+        char *nl;
+        while ((nl = memchr(buf, '\n', *have)) != NULL) {
+            size_t len = (size_t)(nl - buf) + 1;
+            if (lines_left < 0) {
+                size_t k = len - 1 < first_cap - 1 ? len - 1 : first_cap - 1;
+                memcpy(first, buf, k);
+                first[k] = '\0';
+                lines_left = roster && strncmp(first, "OK ", 3) == 0 ? strtol(first + 3, NULL, 10) : 0;
+            } else {
+                lines_left--;
+            }
+            memmove(buf, buf + len, *have - len);
+            *have -= len;
+            if (lines_left == 0) return 0;
+        }
+        if (*have == cap) *have = 0; /* overlong line: skip it */
+        ssize_t r = recv(fd, buf + *have, cap - *have, 0);
+        if (r <= 0) return -1;
+        *have += (size_t)r;
+    }
+}
+
+static int connect_to(Worker *w) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof addr.sun_path, "%s", w->sock);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+        perror("loadgen: connect");
+        w->errors++;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Admin connection: reallocate periodically, timing each publish */
+static void *run_admin(void *arg) {
+    Worker *w = arg;
+    int fd = connect_to(w);
+    if (fd < 0) return NULL;
+    static const char *const reqs[] = { "ALLOCATE balanced\n", "ALLOCATE marks\n" };
+    char buf[4096], first[256];
+    size_t have = 0;
+    struct timespec pause = { w->reallocate_ms / 1000, (long)(w->reallocate_ms % 1000) * 1000000L };
+    for (size_t k = 0; now() < w->deadline; ++k) {
+        nanosleep(&pause, NULL);
+        const char *req = reqs[k % 2];
+        uint64_t t0 = now_ns();
+        if (send(fd, req, strlen(req), 0) != (ssize_t)strlen(req) ||
+            read_reply(fd, buf, sizeof buf, &have, 0, first, sizeof first) != 0) {
+            w->errors++;
+            break;
+        }
+        if (strncmp(first, "OK", 2) != 0) { w->errors++; break; }
+        if (w->n == w->cap) {
+            size_t cap = w->cap ? w->cap * 2 : 64;
+            uint64_t *tmp = realloc(w->lat_ns, sizeof(uint64_t) * cap);
+            if (!tmp) { w->errors++; break; }
+            w->lat_ns = tmp;
+            w->cap = cap;
+        }
+        w->lat_ns[w->n++] = now_ns() - t0;
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *run_worker(void *arg) {
+    Worker *w = arg;
+    int fd = connect_to(w);
+    if (fd < 0) return NULL;
+    uint64_t rng = 0x9E3779B97F4A7C15ull * (uint64_t)(w->id + 1);
+    char buf[1 << 16], req[256], first[256], last_batch[64] = "";
+    size_t have = 0;
+    for (long k = 1; now() < w->deadline; ++k) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        int roster = w->roster_every > 0 && k % w->roster_every == 0 && last_batch[0];
+        int n = roster ? snprintf(req, sizeof req, "ROSTER %s\n", last_batch)
+                       : snprintf(req, sizeof req, "GET %s\n", saps[rng % nsaps]);
+        uint64_t t0 = now_ns();
+        if (send(fd, req, (size_t)n, 0) != n || read_reply(fd, buf, sizeof buf, &have, roster, first, sizeof first) != 0) {
+            w->errors++;
+            break;
+        }
+        uint64_t dt = now_ns() - t0;
+        if (strncmp(first, "OK", 2) != 0) w->not_found++;
+        else if (!roster) {
+            /* remember the batch: the fifth tab-separated field */
+            const char *p = first;
+            for (int f = 0; f < 4 && p; ++f) { p = strchr(p, '\t'); if (p) p++; }
+            if (p && strcmp(p, "-") != 0) snprintf(last_batch, sizeof last_batch, "%s", p);
+        }
+        if (w->n == w->cap) {
+            size_t cap = w->cap ? w->cap * 2 : 65536;
+            uint64_t *tmp = realloc(w->lat_ns, sizeof(uint64_t) * cap);
+            if (!tmp) { w->errors++; break; }
+            w->lat_ns = tmp;
+            w->cap = cap;
+        }
+        w->lat_ns[w->n++] = dt;
+    }
+    close(fd);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(const uint64_t *v, size_t n, double p) {
+    if (n == 0) return 0;
+    size_t i = (size_t)(p * (double)(n - 1) + 0.5);
+    return (double)v[i] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: loadgen SOCKET STUDENTS_CSV [CONNECTIONS] [SECONDS] [ROSTER_EVERY] [REALLOCATE_MS]\n");
+        return 1;
+    }
+    int conns = argc > 3 ? atoi(argv[3]) : 4;
+    double secs = argc > 4 ? atof(argv[4]) : 5;
+    int roster_every = argc > 5 ? atoi(argv[5]) : 0;
+    int reallocate_ms = argc > 6 ? atoi(argv[6]) : 0;
+    if (conns < 1 || conns > MAX_CONNECTIONS || secs <= 0) {
+        fprintf(stderr, "loadgen: need 1..%d connections and a positive duration\n", MAX_CONNECTIONS);
+        return 1;
+    }
+    if (load_saps(argv[2]) != 0) { fprintf(stderr, "loadgen: no SAPs read from %s\n", argv[2]); return 1; }
+
+    /* the admin connection, if any, is the extra last worker */
+    int nthreads = conns + (reallocate_ms > 0);
+    Worker *ws = calloc((size_t)nthreads, sizeof(Worker));
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    if (!ws || !tids) { fprintf(stderr, "loadgen: out of memory\n"); return 1; }
+    double start = now();
+    for (int i = 0; i < nthreads; ++i) {
+        ws[i] = (Worker){ .id = i, .sock = argv[1], .deadline = start + secs, .roster_every = roster_every,
+                          .reallocate_ms = i == conns ? reallocate_ms : 0 };
+        if (pthread_create(&tids[i], NULL, i == conns ? run_admin : run_worker, &ws[i]) != 0) {
+            fprintf(stderr, "loadgen: cannot start threads\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < nthreads; ++i) pthread_join(tids[i], NULL);
+    double elapsed = now() - start;
+
+    double realloc_ms = 0;
+    size_t reallocs = 0;
+    if (reallocate_ms > 0) {
+        Worker *a = &ws[conns];
+        for (size_t i = 0; i < a->n; ++i) realloc_ms += a->lat_ns[i] / 1e6;
+        reallocs = a->n;
+        if (reallocs) realloc_ms /= (double)reallocs;
+        if (a->errors) fprintf(stderr, "loadgen: reallocation requests failed\n");
+        free(a->lat_ns);
+    }
+
+    size_t total = 0;
+    long not_found = 0, errors = 0;
+    for (int i = 0; i < conns; ++i) { total += ws[i].n; not_found += ws[i].not_found; errors += ws[i].errors; }
+    uint64_t *all = malloc(sizeof(uint64_t) * (total ? total : 1));
+    if (!all) { fprintf(stderr, "loadgen: out of memory\n"); return 1; }
+    size_t k = 0;
+    for (int i = 0; i < conns; ++i) {
+        memcpy(all + k, ws[i].lat_ns, sizeof(uint64_t) * ws[i].n);
+        k += ws[i].n;
+        free(ws[i].lat_ns);
+    }
+    qsort(all, total, sizeof(uint64_t), cmp_u64);
+    printf("{\"op\":\"serve_lookup\",\"connections\":%d,\"roster_every\":%d,\"seconds\":%.3f,\"queries\":%zu,"
+           "\"qps\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"not_found\":%ld,\"errors\":%ld,"
+           "\"reallocations\":%zu,\"reallocate_ms_avg\":%.1f}\n",
+           conns, roster_every, elapsed, total, total / elapsed, percentile_us(all, total, 0.50),
+           percentile_us(all, total, 0.99), total ? all[total - 1] / 1000.0 : 0.0, not_found, errors,
+           reallocs, realloc_ms);
+    free(all);
+    free(ws);
+    free(tids);
+    for (size_t i = 0; i < nsaps; ++i) free(saps[i]);
+    free(saps);
+    return errors ? 2 : 0;
+}
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "csvscan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stats.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+static int read_all(int fd, CsvFile *cf) {
+    size_t cap = 1 << 16, len = 0;
+    char *buf = stats_malloc(cap);
+    if (!buf) return -1;
+    for (;;) {
+        if (len == cap) {
+            char *tmp = stats_realloc(buf, cap * 2);
+            if (!tmp) { stats_free(buf); return -1; }
+            buf = tmp; cap *= 2;
+        }
+        ssize_t r = read(fd, buf + len, cap - len);
+        if (r < 0) { stats_free(buf); return -1; }
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+    cf->data = buf;
+    cf->size = len;
+    cf->mapped = 0;
+    return 0;
+}
+
+int csv_open(const char *path, CsvFile *cf) {
+    memset(cf, 0, sizeof *cf);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+
+    int rc = 0;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            posix_madvise(m, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            cf->data = m;
+            cf->size = (size_t)st.st_size;
+            cf->mapped = 1;
+        } else {
+            rc = read_all(fd, cf);
+        }
+    } else if (!S_ISREG(st.st_mode)) {
+        rc = read_all(fd, cf);
+    }
+    close(fd);
+    return rc;
+}
+
+void csv_close(CsvFile *cf) {
+    if (cf->mapped) munmap((void *)cf->data, cf->size);
+    else stats_free((void *)cf->data);
+    memset(cf, 0, sizeof *cf);
+}
+
+size_t csv_count_rows(const char *p, const char *end) {
+    size_t rows = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        rows++;
+        if (!nl) break;
+        p = nl + 1;
+    }
+    return rows;
+}
+
+const char *csv_next_line(const char *p, const char *end) {
+    if (p >= end) return end;
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    return nl ? nl + 1 : end;
+}
+
+/* First byte in [p, end) that is ',', '\n' or '"', or end. The vector
+ * paths test 16 bytes per step; plain text is the common case. */
+static const char *scan_special(const char *p, const char *end) {
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(','), nl = _mm_set1_epi8('\n'), quote = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, nl)),
+                                 _mm_cmpeq_epi8(v, quote));
+        int bits = _mm_movemask_epi8(m);
+        if (bits) return p + __builtin_ctz((unsigned)bits);
+        p += 16;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x16_t comma = vdupq_n_u8(','), nl = vdupq_n_u8('\n'), quote = vdupq_n_u8('"');
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, comma), vceqq_u8(v, nl)), vceqq_u8(v, quote));
+        /* narrow to one nibble per byte so the first hit can be located with ctz */
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (bits) return p + (__builtin_ctzll(bits) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '\n' && *p != '"') ++p;
+    return p;
+}
+
+int csv_next_record(const char **pos, const char *end, CsvField *fields, int max) {
+    const char *p = *pos;
+    if (p >= end) return 0;
+    int n = 0;
+    for (;;) {
+        CsvField f = { p, 0, 0 };
+        if (p < end && *p == '"') {
+            /* quoted field: runs to the next quote not followed by another quote */
+            f.quoted = 1;
+            f.p = ++p;
+            for (;;) {
+                const char *q = memchr(p, '"', (size_t)(end - p));
+                if (!q) { p = end; break; }
+                if (q + 1 < end && q[1] == '"') { p = q + 2; continue; }
+                p = q;
+                break;
+            }
+            f.len = (size_t)(p - f.p);
+            if (p < end) ++p; /* closing quote */
+            /* tolerate stray bytes between the closing quote and the delimiter */
+            while (p < end && *p != ',' && *p != '\n') ++p;
+        } else {
+            for (;;) {
+                p = scan_special(p, end);
+                if (p < end && *p == '"') { ++p; continue; } /* quote inside an unquoted field is data */
+                break;
+            }
+            f.len = (size_t)(p - f.p);
+            if (f.len > 0 && f.p[f.len - 1] == '\r' && (p >= end || *p == '\n')) f.len--;
+        }
+        if (n < max) fields[n] = f;
+        n++;
+        if (p < end && *p == ',') { ++p; continue; }
+        if (p < end) ++p; /* newline */
+        break;
+    }
+    *pos = p;
+    return n;
+}
+
+size_t csv_field_copy(const CsvField *f, char *dst, size_t n) {
+    if (n == 0) return 0;
+    size_t o = 0;
+    for (size_t i = 0; i < f->len && o + 1 < n; ++i) {
+        dst[o++] = f->p[i];
+        if (f->quoted && f->p[i] == '"' && i + 1 < f->len && f->p[i + 1] == '"') ++i;
+    }
+    dst[o] = '\0';
+    return o;
+}
+
+int csv_field_is(const CsvField *f, const char *name) {
+    size_t i = 0;
+    for (; i < f->len && name[i]; ++i) {
+        char a = f->p[i], b = name[i];
+        if (a >= 'A' && a <= 'Z') a = (char)(a - 'A' + 'a');
+        if (b >= 'A' && b <= 'Z') b = (char)(b - 'A' + 'a');
+        if (a != b) return 0;
+    }
+    return i == f->len && name[i] == '\0';
+}
@@ -0,0 +1,47 @@
+#ifndef CSVSCAN_H
+#define CSVSCAN_H
+
+#include <stddef.h>
+
+/* A whole CSV file held in memory: mmap'd when possible, read into a
+ * heap buffer otherwise (pipes, special files). */
+typedef struct {
+    const char *data;
+    size_t size;
+    int mapped;
+} CsvFile;
+
+/* One field of a record. p/len point into the file buffer (zero-copy);
+ * for quoted fields they exclude the surrounding quotes but may still
+ * contain doubled "" escapes, which csv_field_copy() resolves. */
+typedef struct {
+    const char *p;
+    size_t len;
+    int quoted;
+} CsvField;
+
+/* Map path into memory. Returns 0 on success, -1 on error (errno set). */
+int csv_open(const char *path, CsvFile *cf);
+void csv_close(CsvFile *cf);
+
+/* Number of records in [p, end): newline count, plus one for an
+ * unterminated last line. An upper bound when quoted fields span lines. */
+size_t csv_count_rows(const char *p, const char *end);
+
+/* Start of the line after the first newline at or after p, or end. Used
+ * to cut a buffer into chunks that can be parsed independently. */
+const char *csv_next_line(const char *p, const char *end);
+
+/* Parse the record at *pos, storing up to max fields. Advances *pos past
+ * the record terminator and returns the number of fields in the record
+ * (which may exceed max; the extra fields are skipped). Returns 0 at end. */
+int csv_next_record(const char **pos, const char *end, CsvField *fields, int max);
+
+/* Copy a field into dst (always NUL-terminated, truncated to n - 1 bytes),
+ * unescaping "" inside quoted fields. Returns the number of bytes written. */
+size_t csv_field_copy(const CsvField *f, char *dst, size_t n);
+
+/* Case-insensitive match of a field against a NUL-terminated name */
+int csv_field_is(const CsvField *f, const char *name);
+
+#endif /* CSVSCAN_H */
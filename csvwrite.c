@@ -0,0 +1,128 @@
+#include "csvwrite.h"
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+#define CSVW_BUF_SIZE (1 << 20)
+
+int csvw_open(CsvWriter *w, const char *path) {
+    memset(w, 0, sizeof *w);
+    w->buf = stats_malloc(CSVW_BUF_SIZE);
+    if (!w->buf) return -1;
+    w->f = fopen(path, "w");
+    if (!w->f) { stats_free(w->buf); w->buf = NULL; return -1; }
+    /* every write is already a full buffer; skip stdio's own copy */
+    setvbuf(w->f, NULL, _IONBF, 0);
+    w->cap = CSVW_BUF_SIZE;
+    return 0;
+}
+
+static void csvw_flush(CsvWriter *w) {
+    if (w->len && !w->error && fwrite(w->buf, 1, w->len, w->f) != w->len) w->error = 1;
+    w->len = 0;
+}
+
+/* Make room for n more bytes */
+static inline char *csvw_room(CsvWriter *w, size_t n) {
+    if (w->cap - w->len < n) csvw_flush(w);
+    return w->buf + w->len;
+}
+
+int csvw_close(CsvWriter *w) {
+    if (!w->f) return -1;
+    csvw_flush(w);
+    if (fclose(w->f) != 0) w->error = 1;
+    stats_free(w->buf);
+    int rc = w->error ? -1 : 0;
+    memset(w, 0, sizeof *w);
+    return rc;
+}
+
+/* Slow path for fields that do not fit in the buffer at all */
+static void csvw_put(CsvWriter *w, const char *s, size_t n) {
+    while (n > 0) {
+        size_t room = w->cap - w->len;
+        if (room == 0) { csvw_flush(w); room = w->cap; }
+        size_t k = n < room ? n : room;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+void csvw_field(CsvWriter *w, char sep, const char *s, size_t n) {
+    size_t quotes = 0;
+    int special = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[i];
+        if (c == '"') quotes++;
+        else if (c == ',' || c == '\n' || c == '\r') special = 1;
+    }
+    if (quotes) special = 1;
+    size_t need = n + quotes + 3;
+    if (need > w->cap) {
+        if (sep) csvw_put(w, &sep, 1);
+        if (!special) { csvw_put(w, s, n); return; }
+        csvw_put(w, "\"", 1);
+        for (size_t i = 0; i < n; ++i) {
+            csvw_put(w, &s[i], 1);
+            if (s[i] == '"') csvw_put(w, "\"", 1);
+        }
+        csvw_put(w, "\"", 1);
+        return;
+    }
+    char *p = csvw_room(w, need);
+    if (sep) *p++ = sep;
+    if (!special) {
+        memcpy(p, s, n);
+        p += n;
+    } else {
+        *p++ = '"';
+        for (size_t i = 0; i < n; ++i) {
+            *p++ = s[i];
+            if (s[i] == '"') *p++ = '"';
+        }
+        *p++ = '"';
+    }
+    w->len = (size_t)(p - w->buf);
+}
+
+void csvw_str(CsvWriter *w, char sep, const char *s) {
+    csvw_field(w, sep, s, strlen(s));
+}
+
+void csvw_raw(CsvWriter *w, const char *s) {
+    csvw_put(w, s, strlen(s));
+}
+
+void csvw_int(CsvWriter *w, char sep, long long v) {
+    char tmp[24];
+    char *e = tmp + sizeof tmp, *d = e;
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    do { *--d = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--d = '-';
+    char *p = csvw_room(w, (size_t)(e - d) + 1);
+    if (sep) *p++ = sep;
+    memcpy(p, d, (size_t)(e - d));
+    w->len = (size_t)(p + (e - d) - w->buf);
+}
+
+void csvw_fixed(CsvWriter *w, char sep, long long v, int places) {
+    char tmp[48];
+    char *e = tmp + sizeof tmp, *d = e;
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    for (int i = 0; i < places && i < 20; ++i) { *--d = (char)('0' + u % 10); u /= 10; }
+    if (places > 0) *--d = '.';
+    do { *--d = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--d = '-';
+    char *p = csvw_room(w, (size_t)(e - d) + 1);
+    if (sep) *p++ = sep;
+    memcpy(p, d, (size_t)(e - d));
+    w->len = (size_t)(p + (e - d) - w->buf);
+}
+
+void csvw_end_row(CsvWriter *w) {
+    *csvw_room(w, 1) = '\n';
+    w->len++;
+}
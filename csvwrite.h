@@ -0,0 +1,40 @@
+#ifndef CSVWRITE_H
+#define CSVWRITE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Buffered CSV output. Rows are formatted straight into one large buffer
+ * that goes to the file in big writes; numbers are formatted by hand
+ * rather than through printf. Errors are sticky and reported by
+ * csvw_close(), so a writer can be fed without checking every call. */
+typedef struct {
+    FILE *f;
+    char *buf;
+    size_t len, cap;
+    int error;
+} CsvWriter;
+
+/* Create or truncate path. Returns 0, or -1 on error (errno set). */
+int csvw_open(CsvWriter *w, const char *path);
+
+/* Flush, close and release the writer. Returns 0 if everything reached
+ * the file, -1 otherwise. */
+int csvw_close(CsvWriter *w);
+
+/* Append one field, quoted only when it contains a comma, quote, CR or LF
+ * (quotes inside are doubled). sep is written first unless it is 0. */
+void csvw_field(CsvWriter *w, char sep, const char *s, size_t n);
+void csvw_str(CsvWriter *w, char sep, const char *s);
+
+/* Append text verbatim, e.g. a header row */
+void csvw_raw(CsvWriter *w, const char *s);
+void csvw_int(CsvWriter *w, char sep, long long v);
+
+/* Append v / 10^places with exactly places decimals (6724, 2 -> "67.24") */
+void csvw_fixed(CsvWriter *w, char sep, long long v, int places);
+
+/* End the current row */
+void csvw_end_row(CsvWriter *w);
+
+#endif /* CSVWRITE_H */
@@ -0,0 +1,286 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "stats.h"
+
+#define JOURNAL_MAGIC "SRMSJRNL"
+#define JOURNAL_VERSION 1u
+#define JOURNAL_ENDIAN 0x01020304u
+#define JOURNAL_RECORD_MAX (1u << 20)
+/* buffered records past this are written out before the commit */
+#define JOURNAL_BUFFER_MAX (1u << 20)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t base;
+    uint32_t reserved;
+} JournalHeader;
+
+static uint32_t fnv1a(const char *p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Make a rename in path's directory durable */
+static void sync_dir_of(const char *path) {
+    char dir[1024];
+    const char *slash = strrchr(path, '/');
+    if (!slash) snprintf(dir, sizeof dir, ".");
+    else snprintf(dir, sizeof dir, "%.*s", (int)(slash - path ? slash - path : 1), path);
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static void journal_reset(Journal *j, int fd, uint32_t base, uint64_t size, int records) {
+    j->fd = fd;
+    j->len = j->rec = 0;
+    j->size = size;
+    j->base = base;
+    j->records = records;
+    j->err = 0;
+}
+
+int journal_create(Journal *j, const char *path, uint32_t base) {
+    char tmp[1024];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    if (j->fd >= 0) close(j->fd);
+    j->fd = -1;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    JournalHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, JOURNAL_MAGIC, 8);
+    h.version = JOURNAL_VERSION;
+    h.endian = JOURNAL_ENDIAN;
+    h.base = base;
+    if (write_all(fd, (const char *)&h, sizeof h) != 0 || fdatasync(fd) != 0 || rename(tmp, path) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    sync_dir_of(path);
+    journal_reset(j, fd, base, sizeof h, 0);
+    return 0;
+}
+
+int journal_resume(Journal *j, const char *path, uint32_t base, uint64_t valid, int records) {
+    if (j->fd >= 0) close(j->fd);
+    j->fd = -1;
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)valid) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+        close(fd);
+        return -1;
+    }
+    journal_reset(j, fd, base, valid, records);
+    return 0;
+}
+
+static void journal_reserve(Journal *j, size_t extra) {
+    if (j->err || j->len + extra <= j->cap) return;
+    size_t want = j->cap ? j->cap : 4096;
+    while (want < j->len + extra) want *= 2;
+    char *tmp = stats_realloc(j->buf, want);
+    if (!tmp) { j->err = 1; return; }
+    j->buf = tmp;
+    j->cap = want;
+}
+
+static void journal_put(Journal *j, const void *p, size_t n) {
+    journal_reserve(j, n);
+    if (j->err) return;
+    memcpy(j->buf + j->len, p, n);
+    j->len += n;
+}
+
+void journal_begin(Journal *j, int type) {
+    j->rec = j->len;
+    unsigned char t = (unsigned char)type;
+    uint32_t room[2] = { 0, 0 };   /* length and checksum, filled in by journal_end */
+    journal_put(j, room, sizeof room);
+    journal_put(j, &t, 1);
+}
+
+void journal_put_int(Journal *j, int32_t v) {
+    journal_put(j, &v, sizeof v);
+}
+
+void journal_put_str(Journal *j, const char *s) {
+    size_t n = strlen(s);
+    uint16_t len = (uint16_t)(n > UINT16_MAX ? UINT16_MAX : n);
+    journal_put(j, &len, sizeof len);
+    journal_put(j, s, len);
+}
+
+void journal_end(Journal *j) {
+    if (j->err || j->fd < 0) return;
+    const char *body = j->buf + j->rec + 8;
+    uint32_t hdr[2] = { (uint32_t)(j->len - j->rec - 8), 0 };
+    hdr[1] = fnv1a(body, hdr[0]);
+    memcpy(j->buf + j->rec, hdr, sizeof hdr);
+    j->size += j->len - j->rec;
+    j->records++;
+    j->rec = j->len;
+    if (j->len >= JOURNAL_BUFFER_MAX) {
+        if (write_all(j->fd, j->buf, j->len) != 0) j->err = 1;
+        j->len = j->rec = 0;
+    }
+}
+
+int journal_commit(Journal *j) {
+    if (j->fd < 0) return -1;
+    int err = j->err;
+    if (!err && j->len > 0) err = write_all(j->fd, j->buf, j->len) != 0;
+    if (!err && fdatasync(j->fd) != 0) err = 1;
+    j->len = j->rec = 0;
+    j->err = 0;
+    return err ? -1 : 0;
+}
+
+void journal_close(Journal *j) {
+    if (j->fd >= 0) {
+        journal_commit(j);
+        close(j->fd);
+    }
+    stats_free(j->buf);
+    j->buf = NULL;
+    j->cap = 0;
+    j->fd = -1;
+}
+
+int32_t journal_get_int(JournalReader *r) {
+    int32_t v = 0;
+    if ((size_t)(r->end - r->p) < sizeof v) { r->bad = 1; return 0; }
+    memcpy(&v, r->p, sizeof v);
+    r->p += sizeof v;
+    return v;
+}
+
+void journal_get_str(JournalReader *r, char *dst, size_t n) {
+    uint16_t len = 0;
+    dst[0] = '\0';
+    if ((size_t)(r->end - r->p) < sizeof len) { r->bad = 1; return; }
+    memcpy(&len, r->p, sizeof len);
+    r->p += sizeof len;
+    if ((size_t)(r->end - r->p) < len) { r->bad = 1; return; }
+    size_t keep = len < n - 1 ? len : n - 1;
+    memcpy(dst, r->p, keep);
+    dst[keep] = '\0';
+    r->p += len;
+}
+
+/* Whole file into a heap buffer. Returns 0, -1 if it cannot be read. */
+static int read_file(const char *path, char **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    size_t n = (size_t)st.st_size, got = 0;
+    char *buf = stats_malloc(n ? n : 1);
+    if (!buf) { close(fd); return -1; }
+    while (got < n) {
+        ssize_t r = read(fd, buf + got, n - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    *data = buf;
+    *size = got;
+    return 0;
+}
+
+static int check_header(const char *data, size_t size, uint32_t *base) {
+    JournalHeader h;
+    if (size < sizeof h) return -2;
+    memcpy(&h, data, sizeof h);
+    if (memcmp(h.magic, JOURNAL_MAGIC, 8) != 0 || h.version != JOURNAL_VERSION || h.endian != JOURNAL_ENDIAN)
+        return -2;
+    *base = h.base;
+    return 0;
+}
+
+int journal_peek(const char *path, uint32_t *base) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    char buf[sizeof(JournalHeader)];
+    ssize_t n = read(fd, buf, sizeof buf);
+    close(fd);
+    return check_header(buf, n > 0 ? (size_t)n : 0, base);
+}
+
+int journal_replay(const char *path, uint32_t *base, uint64_t *valid, int *failed, JournalApplyFn apply, void *ctx) {
+    char *data;
+    size_t size;
+    *failed = 0;
+    *valid = 0;
+    if (read_file(path, &data, &size) != 0) return -1;
+    if (check_header(data, size, base) != 0) { stats_free(data); return -2; }
+
+    size_t pos = sizeof(JournalHeader);
+    int records = 0;
+    for (;;) {
+        uint32_t hdr[2];
+        if (size - pos < sizeof hdr) break;
+        memcpy(hdr, data + pos, sizeof hdr);
+        const char *body = data + pos + sizeof hdr;
+        if (hdr[0] < 1 || hdr[0] > JOURNAL_RECORD_MAX || hdr[0] > size - pos - sizeof hdr) break;
+        if (fnv1a(body, hdr[0]) != hdr[1]) break;
+        JournalReader r = { body + 1, body + hdr[0], 0 };
+        if (apply((unsigned char)body[0], &r, ctx) != 0 || r.bad) (*failed)++;
+        records++;
+        pos += sizeof hdr + hdr[0];
+    }
+    *valid = pos;
+    stats_free(data);
+    return records;
+}
+
+int journal_fork(Journal *j, int (*task)(void *ctx), void *ctx) {
+    if (j->child) return -1;
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) _exit(task(ctx) == 0 ? 0 : 1);
+    j->child = (long)pid;
+    return 0;
+}
+
+int journal_reap(Journal *j, int wait) {
+    if (!j->child) return 0;
+    int status;
+    pid_t r;
+    do r = waitpid((pid_t)j->child, &status, wait ? 0 : WNOHANG);
+    while (r < 0 && errno == EINTR);
+    if (r == 0) return 0;
+    j->child = 0;
+    return r > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 1 : -1;
+}
@@ -0,0 +1,85 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Append-only write-ahead journal of small typed records. The file starts
+ * with a header naming the snapshot generation it applies to (base), then
+ * holds records of
+ *
+ *   uint32 length, uint32 checksum, uint8 type, fields...
+ *
+ * where the checksum (FNV-1a) covers the type and fields. Records are
+ * built in memory and reach the file at journal_commit, which writes them
+ * and fdatasyncs once, so an operation that logs many records (a bulk
+ * delete) pays for one sync. A crash can only tear the tail: replay stops
+ * at the first short or damaged record and appending resumes there. */
+typedef struct {
+    int fd;              /* -1 when closed */
+    char *buf;           /* records not yet written */
+    size_t len, cap;
+    size_t rec;          /* start of the record being built */
+    uint64_t size;       /* bytes in the file, buffered records included */
+    uint32_t base;
+    int records;         /* records since the header */
+    int err;             /* a write failed; cleared by the next commit */
+    long child;          /* background task running, or 0 */
+} Journal;
+
+/* Start an empty journal at path (atomically replacing any old one).
+ * Returns 0, or -1 with j closed. */
+int journal_create(Journal *j, const char *path, uint32_t base);
+
+/* Reopen path to append after its first valid bytes (from
+ * journal_replay), cutting off a torn tail. Returns 0, or -1. */
+int journal_resume(Journal *j, const char *path, uint32_t base, uint64_t valid, int records);
+
+/* Build one record: begin, put its fields in order, end */
+void journal_begin(Journal *j, int type);
+void journal_put_int(Journal *j, int32_t v);
+void journal_put_str(Journal *j, const char *s);
+void journal_end(Journal *j);
+
+/* Write the buffered records and sync them. Returns 0, or -1 if any
+ * record since the last commit could not be made durable. */
+int journal_commit(Journal *j);
+
+/* Commit, then close. Does not wait for a background task. */
+void journal_close(Journal *j);
+
+/* The fields of one record, read back in the order they were put */
+typedef struct {
+    const char *p, *end;
+    int bad;             /* read past the end or a malformed field */
+} JournalReader;
+
+int32_t journal_get_int(JournalReader *r);
+/* Copies into dst (NUL-terminated, truncated to n - 1 bytes) */
+void journal_get_str(JournalReader *r, char *dst, size_t n);
+
+/* Returns 0 if the record applied, -1 if it did not (it is counted and
+ * skipped; replay goes on) */
+typedef int (*JournalApplyFn)(int type, JournalReader *r, void *ctx);
+
+/* Read path's header into *base and apply every intact record in order.
+ * Returns the number of records read (applied or not) and sets *valid to
+ * the bytes they span; -1 if path does not exist, -2 if it is not a
+ * journal. *failed counts records apply rejected. */
+int journal_replay(const char *path, uint32_t *base, uint64_t *valid, int *failed, JournalApplyFn apply, void *ctx);
+
+/* Just the header: 0 and *base, or -1 / -2 as for journal_replay */
+int journal_peek(const char *path, uint32_t *base);
+
+/* Run task in a forked child, which sees a copy-on-write image of the
+ * process as it is now, so the parent carries on while it works. Used to
+ * write a snapshot without pausing edits. Returns 0 once started, -1 if
+ * the child could not be created (nothing ran). One task at a time. */
+int journal_fork(Journal *j, int (*task)(void *ctx), void *ctx);
+
+/* Collect the background task: 0 if none has finished (or none runs), 1
+ * if it finished and task returned 0, -1 if it failed. With wait, blocks
+ * until it finishes. */
+int journal_reap(Journal *j, int wait);
+
+#endif /* JOURNAL_H */
@@ -6,50 +6,221 @@
  *  - All other functionality is inside Admin Menu:
  *      - Add / View / Update / Delete students
  *      - Add / View batches
- *      - Allocation strategies
- *      - Save / Load CSV
+ *      - Allocation strategies, and a side-by-side comparison of them
+ *      - Save / Load CSV, and merge more CSVs into the loaded students
+ *      - Save / Load binary snapshot (students, batches and allocation together)
+ *      - Every admin edit journaled to srms.journal and replayed at startup
  *      - Summary report
+ *  - Headless mode for scripted runs:
+ *      srms allocate --in students.csv --batches spec.csv --strategy marks --out result.csv
+ *  - Benchmark mode (`make bench`): srms bench --in FILE --batches FILE [--prefs FILE]
  *
- * Compile: gcc -std=c11 -O2 -Wall -o srms main.c intro.c outro.c
+ * Build: make
+ *   or   gcc -std=c11 -O2 -Wall -pthread -o srms main.c intro.c outro.c order.c csvscan.c csvwrite.c strpool.c pool.c mcflow.c serve.c nameidx.c rng.c journal.c stats.c -lm
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <pthread.h>
 #include "intro.h"
 #include "outro.h"
+#include "order.h"
+#include "csvscan.h"
+#include "csvwrite.h"
+#include "strpool.h"
+#include "pool.h"
+#include "mcflow.h"
+#include "serve.h"
+#include "nameidx.h"
+#include "rng.h"
+#include "journal.h"
+#include "stats.h"
 
-#define MAX_STUDENTS 1000
-#define MAX_BATCHES 100
 #define NAME_LEN 100
 #define SAP_LEN 32
 #define MAX_LINE_LEN 512
+#define SNAPSHOT_FILE "srms.snap"
+#define JOURNAL_FILE "srms.journal"
+#define JOURNAL_OLD_FILE "srms.journal.old"        /* being folded into a snapshot */
+#define JOURNAL_UNAPPLIED_FILE "srms.journal.unapplied"
+#define PREF_MAX 32
+#define SERVE_SOCKET "srms.sock"
+#define RANDOM_TRIALS_MAX 4096
+#define MERGE_FILES_MAX 32
 
-/* ---------------- Data Structures ---------------- */
+/* Marks are stored as fixed-point hundredths (67.24 -> 6724): students.csv
+ * carries two decimals, and dropping them made many false ties */
+#define MARKS_SCALE 100
+#define MARKS_MAX (100 * MARKS_SCALE)
 
-typedef struct {
-    char sap[SAP_LEN];
-    char name[NAME_LEN];
-    int marks;
-    int allocated_batch; /* -1 if none */
-} Student;
+/* ---------------- Data Structures ---------------- */
 
 typedef struct {
     char name[32];
     int capacity;
     int filled;
-    int *members; /* indices into students[] */
+    int course;   /* course served, or -1 for any */
+    int *members; /* student indices */
 } Batch;
 
+/* Student orderings produced by the allocation strategies */
+typedef enum {
+    ORDER_NONE,
+    ORDER_MARKS_DESC,
+    ORDER_NAME_ASC,
+    ORDER_NAME_DESC,
+    ORDER_SAP_ASC,
+    ORDER_RANDOM
+} OrderKind;
+
 /* ---------------- Globals ---------------- */
 
-static Student *students = NULL;
+/* Students are stored as parallel arrays (structure-of-arrays). The hot
+ * fields that scans and allocation passes touch are dense ints; SAP and
+ * name live in student_strs and are referenced by offset. All arrays share
+ * student_cap and grow geometrically.
+ *
+ * A student's slot is a stable handle: deleting a student frees its slot
+ * (st_gen becomes even, the slot goes on free_slots) instead of shifting
+ * the arrays, so batch members, the SAP index and the allocation order
+ * never need renumbering. Loops run over [0, student_slots) and skip dead
+ * slots; student_count is the number of live students. */
+static int *st_marks = NULL;
+static int *st_batch = NULL;       /* allocated batch, -1 if none */
+static int *st_member_pos = NULL;  /* position in batches[st_batch].members */
+static int *st_course = NULL;      /* index into course_offs, -1 if none */
+static uint32_t *st_sap = NULL;
+static uint32_t *st_name = NULL;
+static uint32_t *st_gen = NULL;    /* odd while the slot is live, bumped on every free/reuse */
+static int student_slots = 0;
 static int student_count = 0;
+static int student_cap = 0;
+
+static int *free_slots = NULL;
+static int free_count = 0;
+static int free_cap = 0;
+
+static StrPool student_strs;
+
+/* Distinct course names, interned in student_strs */
+static uint32_t *course_offs = NULL;
+static int course_count = 0;
+static int course_cap = 0;
 
 static Batch *batches = NULL;
 static int batch_count = 0;
+static int batch_cap = 0;
+
+/* SAP -> student index lookup table (open addressing, linear probing).
+ * idx == -1 marks an empty slot; sap_cap is always a power of two. */
+typedef struct {
+    uint32_t hash;
+    int idx;
+} SapSlot;
+
+static SapSlot *sap_slots = NULL;
+static int sap_cap = 0;
+static int sap_used = 0;
+
+/* Name search over every live student. Built by the first name search
+ * after a load, so loads that are never searched by name do not pay for
+ * the sort, then kept current by edits. An edit that runs out of memory
+ * drops it (built = 0) and the next search builds it again. */
+static NameIndex name_index;
+
+/* The order behind the current allocation. Kept (and kept in sync with
+ * edits) so that, with incremental_alloc on, adds and deletes can be folded
+ * into the allocation without re-running the strategy. */
+static OrderKind alloc_kind = ORDER_NONE;
+static int *alloc_order = NULL;
+static int alloc_order_len = 0;
+static int alloc_order_cap = 0;
+static int alloc_order_dead = 0;   /* entries whose student was deleted */
+static int alloc_wait_hint = 0;    /* every live entry before this is seated */
+static int incremental_alloc = 0;
+
+/* Allocate each course separately, into the batches tagged with it */
+static int course_partitioned = 0;
+
+/* Order-based strategies deal students out round-robin by default; with
+ * this on, each batch gets seats in proportion to its capacity, so batches
+ * of different sizes fill at the same rate (see OpenBatches) */
+static int proportional_placement = 0;
+
+/* Random allocation. Each run takes random_next_seed and records it in
+ * random_last; running again with that seed (--seed) and the same trial
+ * count replays the allocation. With random_trials > 1 that many shuffles
+ * are scored in parallel and the best-balanced one is kept. */
+typedef struct {
+    int valid;
+    uint64_t seed;
+    int trials;
+    int proportional;        /* placement the shuffle was seated with */
+    int best;                /* winning trial */
+    double score, mean_score;
+} RandomRun;
+
+static uint64_t random_next_seed = 0;
+static int random_seeded = 0;          /* random_next_seed set (--seed, or on first use) */
+static int random_trials = 1;
+static RandomRun random_last;
+static Rng order_rng;        /* where incremental adds land in a random order */
+
+/* Ranked batch preferences as loaded: one record per student, flattened as
+ * sap, count, then count batch names (offsets into pref_strs). Kept by SAP
+ * and name rather than slot and index so they survive edits and reloads;
+ * the preference strategy resolves them when it runs. */
+static StrPool pref_strs;
+static uint32_t *pref_items = NULL;
+static int pref_items_len = 0;
+static int pref_items_cap = 0;
+static int pref_records = 0;
+
+/* Instrumentation for the Summary Report: the last operation of each phase */
+typedef enum { PHASE_LOAD, PHASE_SAVE, PHASE_SORT, PHASE_ALLOCATE, PHASE_COUNT } Phase;
+static const char *const phase_names[PHASE_COUNT] = { "load", "save", "sort", "allocate" };
+
+typedef struct {
+    int valid;
+    char op[96];
+    double seconds;
+    uint64_t items;
+    uint64_t comparisons;   /* key comparisons (radix passes make none) */
+    uint64_t allocs;        /* heap allocation calls */
+    long peak_kb;           /* peak resident memory, -1 if unknown */
+    int peak_scoped;        /* peak covers this operation, not the whole process */
+} PhaseStats;
+
+typedef struct {
+    double t0;
+    uint64_t allocs0;
+} PhaseMark;
+
+static PhaseStats phase_stats[PHASE_COUNT];
+static int phase_depth = 0;       /* open phases; nested ones share the outer peak window */
+static int phase_peak_scoped = 0;
+static uint64_t alloc_comparisons = 0;  /* comparisons made by the running strategy */
+
+/* Set by the command-line mode: status chatter is suppressed and errors go to stderr */
+static int headless = 0;
+
+/* Write-ahead journal of admin edits, on in interactive mode only. Its
+ * base is the generation of the snapshot it applies to; snap_generation is
+ * stamped into snapshots written and read back from snapshots loaded. */
+static Journal journal = { .fd = -1 };
+static int journal_on = 0;
+static uint32_t snap_generation = 0;
+
+/* Modification time of the file the data was last loaded from; merge-import
+ * dates the rows already loaded with it */
+static long long db_stamp = 0;
 
 /* ---------------- Utility Prototypes ---------------- */
 
@@ -58,6 +229,31 @@ static int find_student_by_sap(const char *sap);
 static void print_separator(void);
 static void safe_strdup_truncate(char *dst, const char *src, size_t n);
 static int file_exists(const char *path);
+static long long file_mtime(const char *path);
+static void report(const char *fmt, ...);
+static void report_error(const char *fmt, ...);
+static int reserve_students(int n);
+static int reserve_batches(int n);
+static void free_batches(void);
+static const char *student_sap(int i);
+static const char *student_name(int i);
+static const char *student_course(int i);
+static const char *course_name(int c);
+static int student_alive(int i);
+
+/* ---------------- SAP Index Prototypes ---------------- */
+
+static uint32_t sap_hash(const char *sap);
+static int sap_index_insert(int idx);
+static int sap_index_reserve(int n);
+static void sap_index_remove(int idx);
+static void sap_index_rebuild(void);
+static void sap_index_free(void);
+
+/* ---------------- Name Index Prototypes ---------------- */
+
+static int name_index_rebuild(void);
+static void name_index_add(int idx);
 
 /* ---------------- Student / Batch Prototypes ---------------- */
 
@@ -66,21 +262,51 @@ static void add_student_interactive(void);
 static void view_students(void);
 static void update_student(void);
 static void delete_student(void);
+static void remove_student(int idx);
+static void delete_students_from_file(void);
 
 static void add_batch(void);
 static void view_batches(void);
 
 /* ---------------- Allocation Prototypes ---------------- */
 
-static void allocation_by_marks(void);
-static void allocation_alphabetical(int reverse);
-static void allocation_by_sap_asc(void);
-static void allocation_random(void);
+static int allocation_by_marks(void);
+static int allocation_alphabetical(int reverse);
+static int allocation_by_sap_asc(void);
+static int allocation_random(void);
+static int allocation_balanced(void);
+static int allocation_by_preference(void);
+static void remember_order(OrderKind kind, int *order);
+static void forget_allocation_order(void);
+static void incremental_add(int idx);
+static void incremental_reorder(int idx, int new_marks, uint32_t new_name);
+static void incremental_remove(int idx, int freed_batch);
+static int order_blocks_reuse(void);
+
+/* ---------------- Journal Prototypes ---------------- */
+
+static void wal_log_student(int idx);
+static void wal_log_delete(int idx);
+static void wal_log_seat(int idx);
+static void wal_log_batch(int b);
+static void wal_commit(void);
+static int wal_checkpoint(void);
+static void wal_start(void);
+static void wal_stop(void);
 
 /* ---------------- CSV I/O Prototypes ---------------- */
 
-static void save_csv(const char *filename);
-static void load_csv(const char *filename);
+static int save_csv(const char *filename);
+static int load_csv(const char *filename);
+static int load_batch_spec(const char *filename);
+static int rebuild_batch_members(void);
+static int load_preferences(const char *filename);
+static void free_preferences(void);
+
+/* ---------------- Snapshot Prototypes ---------------- */
+
+static int save_snapshot(const char *filename);
+static int load_snapshot(const char *filename);
 
 /* ---------------- Access & Menus ---------------- */
 
@@ -91,6 +317,19 @@ static void admin_menu(void);
 
 static void print_summary(void);
 static int total_capacity(void);
+static void report_batch_balance(void);
+static void print_random_run(void);
+static void print_phase_table(void);
+static void phase_begin(PhaseMark *m);
+static void phase_end(Phase p, const PhaseMark *m, int rc, const char *op, const char *detail,
+                      uint64_t items, uint64_t comparisons);
+static int write_phase_json(const char *filename);
+
+/* ---------------- Command-line Mode ---------------- */
+
+static int run_cli(int argc, char **argv);
+static int run_bench(int argc, char **argv);
+static int run_serve(int argc, char **argv);
 
 /* ---------------- Utility Implementations ---------------- */
 
@@ -105,8 +344,53 @@ static void print_separator(void) {
 
 static void safe_strdup_truncate(char *dst, const char *src, size_t n) {
     if (n == 0) return;
-    strncpy(dst, src ? src : "", n-1);
-    dst[n-1] = '\0';
+    size_t len = 0;
+    while (src && len < n - 1 && src[len]) len++;
+    if (len > 0) memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/* Parse a decimal mark ("67", "67.2", "67.245") of n bytes into
+ * hundredths, rounding half up past two decimals. Surrounding spaces are
+ * allowed. Returns 0, or -1 if it is not a number. */
+static int parse_marks(const char *s, size_t n, int *out) {
+    const char *p = s, *end = s + n;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+    int neg = p < end && (*p == '-' || *p == '+') ? *p++ == '-' : 0;
+    long long v = 0;
+    int digits = 0, places = 0, round_up = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) if (v < 100000000) v = v * 10 + (*p - '0');
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (places < 2) { v = v * 10 + (*p - '0'); places++; }
+            else if (places++ == 2) round_up = *p >= '5';
+        }
+    }
+    if (digits == 0 || p != end) return -1;
+    for (; places < 2; ++places) v *= 10;
+    v += round_up;
+    if (v > INT32_MAX) v = INT32_MAX;
+    *out = (int)(neg ? -v : v);
+    return 0;
+}
+
+/* Hundredths as "67.24" in buf (at least 16 bytes) */
+static const char *format_marks(int hundredths, char *buf) {
+    unsigned u = hundredths < 0 ? 0u - (unsigned)hundredths : (unsigned)hundredths;
+    snprintf(buf, 16, "%s%u.%02u", hundredths < 0 ? "-" : "", u / MARKS_SCALE, u % MARKS_SCALE);
+    return buf;
+}
+
+/* Read a mark typed at a prompt. Returns 0, 1 for an empty line, or -1
+ * when the line is not a number (or on end of input). */
+static int read_marks(int *out) {
+    char line[64];
+    if (!fgets(line, sizeof line, stdin)) return -1;
+    if (!strchr(line, '\n')) clear_input();
+    size_t n = strcspn(line, "\n");
+    if (n == 0) return 1;
+    return parse_marks(line, n, out);
 }
 
 static int file_exists(const char *path) {
@@ -116,53 +400,403 @@ static int file_exists(const char *path) {
     return 0;
 }
 
+/* Seconds since the epoch, or 0 if path cannot be examined */
+static long long file_mtime(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_mtime : 0;
+}
+
+/* Status message for the interactive user; silent in headless mode */
+static void report(const char *fmt, ...) {
+    if (headless) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+/* Error message: inline with the menus interactively, stderr in headless mode */
+static void report_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(headless ? stderr : stdout, fmt, ap);
+    va_end(ap);
+}
+
+/* ---------------- Storage ---------------- */
+
+/* Grow a buffer of *cap elements to hold at least n, doubling so that
+ * repeated appends cost amortised O(1). Returns 0, or -1 on memory error. */
+static int grow_array(void **buf, int *cap, int n, size_t elem) {
+    if (n <= *cap) return 0;
+    long long want = *cap > 0 ? *cap : 64;
+    while (want < n) want *= 2;
+    if (want > INT32_MAX) want = n;
+    void *tmp = stats_realloc(*buf, elem * (size_t)want);
+    if (!tmp) return -1;
+    *buf = tmp;
+    *cap = (int)want;
+    return 0;
+}
+
+/* Grow one column through a void * copy, as with any other grow_array
+ * caller, so the typed column pointer is never accessed as a void * */
+#define GROW_COLUMN(col, cap, n)                                          \
+    do {                                                                  \
+        void *buf = (col);                                                \
+        if (grow_array(&buf, &(cap), (n), sizeof *(col)) != 0) return -1; \
+        (col) = buf;                                                      \
+    } while (0)
+
+/* Every student column is grown to the same capacity */
+static int reserve_students(int n) {
+    if (n <= student_cap) return 0;
+    int caps[7];
+    for (int c = 0; c < 7; ++c) caps[c] = student_cap;
+    GROW_COLUMN(st_marks, caps[0], n);
+    GROW_COLUMN(st_batch, caps[1], n);
+    GROW_COLUMN(st_member_pos, caps[2], n);
+    GROW_COLUMN(st_course, caps[3], n);
+    GROW_COLUMN(st_sap, caps[4], n);
+    GROW_COLUMN(st_name, caps[5], n);
+    GROW_COLUMN(st_gen, caps[6], n);
+    student_cap = caps[0];
+    return 0;
+}
+
+#undef GROW_COLUMN
+
+/* Forget every student but keep the column buffers */
+static void clear_students(void) {
+    student_slots = 0;
+    student_count = 0;
+    free_count = 0;
+    strpool_clear(&student_strs);
+    course_count = 0;
+    nameidx_clear(&name_index);
+}
+
+static void free_students(void) {
+    stats_free(st_marks); stats_free(st_batch); stats_free(st_member_pos); stats_free(st_course);
+    stats_free(st_sap); stats_free(st_name); stats_free(st_gen); stats_free(free_slots);
+    st_marks = st_batch = st_member_pos = st_course = free_slots = NULL;
+    st_sap = st_name = st_gen = NULL;
+    student_slots = student_count = student_cap = 0;
+    free_count = free_cap = 0;
+    strpool_free(&student_strs);
+    stats_free(course_offs);
+    course_offs = NULL; course_count = 0; course_cap = 0;
+}
+
+/* Everything a load replaces. A load runs on empty globals with the
+ * previous database set aside in one of these, so a load that fails puts
+ * it back untouched and memory keeps matching the snapshot and journal. */
+typedef struct {
+    int *marks, *batch, *member_pos, *course;
+    uint32_t *sap, *name, *gen;
+    int slots, count, cap;
+    int *free_slots;
+    int free_count, free_cap;
+    StrPool strs;
+    uint32_t *course_offs;
+    int course_count, course_cap;
+    Batch *batches;
+    int batch_count, batch_cap;
+    SapSlot *sap_slots;
+    int sap_cap, sap_used;
+    NameIndex name_index;
+    OrderKind alloc_kind;
+    int *alloc_order;
+    int alloc_order_len, alloc_order_cap, alloc_order_dead, alloc_wait_hint;
+} StudentDb;
+
+/* Move the database into d and leave the globals empty */
+static void db_stash(StudentDb *d) {
+    d->marks = st_marks; d->batch = st_batch; d->member_pos = st_member_pos; d->course = st_course;
+    d->sap = st_sap; d->name = st_name; d->gen = st_gen;
+    d->slots = student_slots; d->count = student_count; d->cap = student_cap;
+    d->free_slots = free_slots; d->free_count = free_count; d->free_cap = free_cap;
+    d->strs = student_strs;
+    d->course_offs = course_offs; d->course_count = course_count; d->course_cap = course_cap;
+    d->batches = batches; d->batch_count = batch_count; d->batch_cap = batch_cap;
+    d->sap_slots = sap_slots; d->sap_cap = sap_cap; d->sap_used = sap_used;
+    d->name_index = name_index;
+    d->alloc_kind = alloc_kind; d->alloc_order = alloc_order;
+    d->alloc_order_len = alloc_order_len; d->alloc_order_cap = alloc_order_cap;
+    d->alloc_order_dead = alloc_order_dead; d->alloc_wait_hint = alloc_wait_hint;
+
+    st_marks = st_batch = st_member_pos = st_course = free_slots = alloc_order = NULL;
+    st_sap = st_name = st_gen = course_offs = NULL;
+    student_slots = student_count = student_cap = free_count = free_cap = 0;
+    memset(&student_strs, 0, sizeof student_strs);
+    course_count = course_cap = 0;
+    batches = NULL; batch_count = batch_cap = 0;
+    sap_slots = NULL; sap_cap = sap_used = 0;
+    memset(&name_index, 0, sizeof name_index);
+    alloc_kind = ORDER_NONE;
+    alloc_order_len = alloc_order_cap = alloc_order_dead = alloc_wait_hint = 0;
+}
+
+/* Free the database in the globals and put d's back */
+static void db_restore(StudentDb *d) {
+    free_batches();
+    free_students();
+    sap_index_free();
+    nameidx_free(&name_index);
+    st_marks = d->marks; st_batch = d->batch; st_member_pos = d->member_pos; st_course = d->course;
+    st_sap = d->sap; st_name = d->name; st_gen = d->gen;
+    student_slots = d->slots; student_count = d->count; student_cap = d->cap;
+    free_slots = d->free_slots; free_count = d->free_count; free_cap = d->free_cap;
+    student_strs = d->strs;
+    course_offs = d->course_offs; course_count = d->course_count; course_cap = d->course_cap;
+    batches = d->batches; batch_count = d->batch_count; batch_cap = d->batch_cap;
+    sap_slots = d->sap_slots; sap_cap = d->sap_cap; sap_used = d->sap_used;
+    name_index = d->name_index;
+    alloc_kind = d->alloc_kind; alloc_order = d->alloc_order;
+    alloc_order_len = d->alloc_order_len; alloc_order_cap = d->alloc_order_cap;
+    alloc_order_dead = d->alloc_order_dead; alloc_wait_hint = d->alloc_wait_hint;
+}
+
+/* Free a stashed database, keeping the one in the globals */
+static void db_free(StudentDb *d) {
+    StudentDb live;
+    db_stash(&live);
+    db_restore(d);
+    db_stash(d);
+    db_restore(&live);
+}
+
+static int student_alive(int i) { return st_gen[i] & 1u; }
+
+static const char *student_sap(int i) { return strpool_get(&student_strs, st_sap[i]); }
+static const char *student_name(int i) { return strpool_get(&student_strs, st_name[i]); }
+static const char *student_course(int i) {
+    return course_name(st_course[i]);
+}
+
+static const char *course_name(int c) {
+    return c >= 0 ? strpool_get(&student_strs, course_offs[c]) : "";
+}
+
+/* Course id for a name, registering it on first sight. Returns -1 for an
+ * empty name, -2 on memory error. */
+static int course_id(const char *s, size_t n) {
+    if (n == 0) return -1;
+    uint32_t off = strpool_intern(&student_strs, s, n);
+    if (off == STRPOOL_NONE) return -2;
+    for (int c = 0; c < course_count; ++c) if (course_offs[c] == off) return c;
+    void *buf = course_offs;
+    if (grow_array(&buf, &course_cap, course_count + 1, sizeof(uint32_t)) != 0) return -2;
+    course_offs = buf;
+    course_offs[course_count] = off;
+    return course_count++;
+}
+
+/* Add one student in a free slot (or a new one) and index its SAP.
+ * Returns the slot, -2 if the SAP already exists (nothing is added), or
+ * -1 on memory error. */
+static int append_student(const char *sap, size_t sap_len, const char *name, size_t name_len,
+                          int marks, int course, int batch) {
+    /* a freed slot is only recycled once no stale order entry can refer to it */
+    int reuse = free_count > 0 && !order_blocks_reuse();
+    int i = reuse ? free_slots[free_count - 1] : student_slots;
+    if (!reuse) {
+        if (reserve_students(student_slots + 1) != 0) return -1;
+        st_gen[i] = 0;
+    }
+    /* SAPs are unique by construction, so they are appended rather than interned */
+    st_sap[i] = strpool_add(&student_strs, sap, sap_len);
+    st_name[i] = strpool_intern(&student_strs, name, name_len);
+    if (st_sap[i] == STRPOOL_NONE || st_name[i] == STRPOOL_NONE) return -1;
+    st_marks[i] = marks;
+    st_course[i] = course;
+    st_batch[i] = batch;
+    st_member_pos[i] = -1;
+    int r = sap_index_insert(i);
+    if (r != 0) return r > 0 ? -2 : -1;
+    st_gen[i]++;
+    if (reuse) free_count--;
+    else student_slots++;
+    student_count++;
+    name_index_add(i);
+    return i;
+}
+
+static int reserve_batches(int n) {
+    void *buf = batches;
+    int rc = grow_array(&buf, &batch_cap, n, sizeof(Batch));
+    batches = buf;
+    return rc;
+}
+
+/* ---------------- SAP Index ---------------- */
+
+/* FNV-1a; SAP IDs are short digit strings so this is cheap and spreads well */
+static uint32_t sap_hash(const char *sap) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)sap; *p; ++p) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Resize to new_cap slots and re-insert every live entry */
+static int sap_index_resize(int new_cap) {
+    SapSlot *ns = stats_malloc(sizeof(SapSlot) * new_cap);
+    if (!ns) return -1;
+    for (int i = 0; i < new_cap; ++i) ns[i].idx = -1;
+    int mask = new_cap - 1;
+    for (int i = 0; i < sap_cap; ++i) {
+        if (sap_slots[i].idx < 0) continue;
+        int pos = (int)(sap_slots[i].hash & (uint32_t)mask);
+        while (ns[pos].idx >= 0) pos = (pos + 1) & mask;
+        ns[pos] = sap_slots[i];
+    }
+    stats_free(sap_slots);
+    sap_slots = ns;
+    sap_cap = new_cap;
+    return 0;
+}
+
+/* Index student idx by its SAP. Returns 0 on success, 1 if the SAP is
+ * already indexed (the existing entry is kept), -1 on memory error. */
+static int sap_index_insert(int idx) {
+    if ((sap_used + 1) * 2 > sap_cap) {
+        if (sap_index_resize(sap_cap ? sap_cap * 2 : 64) != 0) return -1;
+    }
+    const char *sap = student_sap(idx);
+    uint32_t h = sap_hash(sap);
+    int mask = sap_cap - 1;
+    int pos = (int)(h & (uint32_t)mask);
+    while (sap_slots[pos].idx >= 0) {
+        if (sap_slots[pos].hash == h && strcmp(student_sap(sap_slots[pos].idx), sap) == 0) return 1;
+        pos = (pos + 1) & mask;
+    }
+    sap_slots[pos].hash = h;
+    sap_slots[pos].idx = idx;
+    sap_used++;
+    return 0;
+}
+
+/* Drop student idx from the index. Uses backward-shift deletion so the
+ * probe chains stay intact without tombstones. */
+static void sap_index_remove(int idx) {
+    if (sap_cap == 0) return;
+    int mask = sap_cap - 1;
+    int pos = (int)(sap_hash(student_sap(idx)) & (uint32_t)mask);
+    while (sap_slots[pos].idx >= 0 && sap_slots[pos].idx != idx) pos = (pos + 1) & mask;
+    if (sap_slots[pos].idx < 0) return;
+
+    int hole = pos;
+    for (int next = (hole + 1) & mask; sap_slots[next].idx >= 0; next = (next + 1) & mask) {
+        int home = (int)(sap_slots[next].hash & (uint32_t)mask);
+        /* move the entry back if its home slot is not inside (hole, next] */
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            sap_slots[hole] = sap_slots[next];
+            hole = next;
+        }
+    }
+    sap_slots[hole].idx = -1;
+    sap_used--;
+}
+
+/* Size the table for n entries up front so bulk loads never rehash */
+static int sap_index_reserve(int n) {
+    int want = 64;
+    while (want < n * 2) want *= 2;
+    return want > sap_cap ? sap_index_resize(want) : 0;
+}
+
+static void sap_index_rebuild(void) {
+    sap_used = 0;
+    for (int i = 0; i < sap_cap; ++i) sap_slots[i].idx = -1;
+    for (int i = 0; i < student_slots; ++i) if (student_alive(i)) sap_index_insert(i);
+}
+
+static void sap_index_free(void) {
+    stats_free(sap_slots);
+    sap_slots = NULL;
+    sap_cap = 0;
+    sap_used = 0;
+}
+
+/* ---------------- Name Index ---------------- */
+
+static const char *name_of_student(int idx, void *ctx) {
+    (void)ctx;
+    return student_name(idx);
+}
+
+/* Index every live student's name in one sort. Returns 0, or -1 on memory
+ * error (the index stays unbuilt). */
+static int name_index_rebuild(void) {
+    int *slots = stats_malloc(sizeof(int) * (size_t)(student_count ? student_count : 1));
+    if (!slots) { nameidx_clear(&name_index); return -1; }
+    int n = 0;
+    for (int i = 0; i < student_slots; ++i) if (student_alive(i)) slots[n++] = i;
+    int rc = nameidx_build(&name_index, slots, n, name_of_student, NULL);
+    stats_free(slots);
+    return rc;
+}
+
+/* Student idx is new or renamed; a no-op until the index is built */
+static void name_index_add(int idx) {
+    if (name_index.built && nameidx_add(&name_index, idx, student_name(idx)) != 0) nameidx_clear(&name_index);
+}
+
 /* ---------------- Student / Batch Implementations ---------------- */
 
 static int find_student_by_sap(const char *sap) {
-    if (!sap) return -1;
-    for (int i = 0; i < student_count; ++i) {
-        if (strcmp(students[i].sap, sap) == 0) return i;
+    if (!sap || sap_cap == 0) return -1;
+    uint32_t h = sap_hash(sap);
+    int mask = sap_cap - 1;
+    for (int pos = (int)(h & (uint32_t)mask); sap_slots[pos].idx >= 0; pos = (pos + 1) & mask) {
+        if (sap_slots[pos].hash == h && strcmp(student_sap(sap_slots[pos].idx), sap) == 0)
+            return sap_slots[pos].idx;
     }
     return -1;
 }
 
 /* Add a single student; no loop here */
 static void add_student_one(void) {
-    if (student_count >= MAX_STUDENTS) {
-        printf("Database is full (max %d). Cannot add more students.\n", MAX_STUDENTS);
-        return;
-    }
-
-    Student st;
-    memset(&st, 0, sizeof st);
+    char sap[SAP_LEN], name[NAME_LEN], course[32];
+    int marks;
 
     printf("Enter SAP ID: ");
-    if (!fgets(st.sap, sizeof st.sap, stdin)) return;
-    st.sap[strcspn(st.sap, "\n")] = '\0';
-    if (strlen(st.sap) == 0) { printf("SAP ID cannot be empty.\n"); return; }
+    if (!fgets(sap, sizeof sap, stdin)) return;
+    sap[strcspn(sap, "\n")] = '\0';
+    if (strlen(sap) == 0) { printf("SAP ID cannot be empty.\n"); return; }
 
-    if (find_student_by_sap(st.sap) != -1) {
+    if (find_student_by_sap(sap) != -1) {
         printf("A student with this SAP already exists.\n");
         return;
     }
 
     printf("Enter Name: ");
-    if (!fgets(st.name, sizeof st.name, stdin)) return;
-    st.name[strcspn(st.name, "\n")] = '\0';
-    if (strlen(st.name) == 0) { printf("Name cannot be empty.\n"); return; }
+    if (!fgets(name, sizeof name, stdin)) return;
+    name[strcspn(name, "\n")] = '\0';
+    if (strlen(name) == 0) { printf("Name cannot be empty.\n"); return; }
 
-    printf("Enter Marks (0-100): ");
-    if (scanf("%d", &st.marks) != 1) { clear_input(); printf("Invalid marks input.\n"); return; }
-    clear_input();
-    if (st.marks < 0 || st.marks > 100) { printf("Marks must be between 0 and 100.\n"); return; }
+    printf("Enter Marks (0-100, up to two decimals): ");
+    if (read_marks(&marks) != 0) { printf("Invalid marks input.\n"); return; }
+    if (marks < 0 || marks > MARKS_MAX) { printf("Marks must be between 0 and 100.\n"); return; }
 
-    st.allocated_batch = -1;
+    printf("Enter Course (or press Enter for none): ");
+    if (!fgets(course, sizeof course, stdin)) return;
+    course[strcspn(course, "\n")] = '\0';
 
-    Student *tmp = realloc(students, sizeof(Student) * (student_count + 1));
-    if (!tmp) { printf("Memory allocation failed.\n"); return; }
-    students = tmp;
-    students[student_count++] = st;
+    int cid = course_id(course, strlen(course));
+    int slot = cid < -1 ? -1 : append_student(sap, strlen(sap), name, strlen(name), marks, cid, -1);
+    if (slot < 0) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
     printf("Student added successfully.\n");
+    wal_log_student(slot);
+    incremental_add(slot);
+    wal_commit();
+    if (st_batch[slot] >= 0) printf("Placed in batch %s.\n", batches[st_batch[slot]].name);
 }
 
 /* Interactive wrapper: ask after each addition whether to add another */
@@ -186,11 +820,13 @@ static void view_students(void) {
         return;
     }
     print_separator();
-    printf("%-10s  %-30s  %-6s  %-6s\n", "SAP", "Name", "Marks", "Batch");
+    printf("%-10s  %-30s  %-6s  %-8s  %-6s\n", "SAP", "Name", "Marks", "Course", "Batch");
     print_separator();
-    for (int i = 0; i < student_count; ++i) {
-        int b = students[i].allocated_batch;
-        printf("%-10s  %-30s  %-6d  %-6d\n", students[i].sap, students[i].name, students[i].marks, b);
+    for (int i = 0; i < student_slots; ++i) {
+        if (!student_alive(i)) continue;
+        char mk[16];
+        printf("%-10s  %-30s  %-6s  %-8s  %-6d\n", student_sap(i), student_name(i), format_marks(st_marks[i], mk),
+               student_course(i), st_batch[i]);
     }
     print_separator();
 }
@@ -202,24 +838,75 @@ static void update_student(void) {
     sap[strcspn(sap, "\n")] = '\0';
     int idx = find_student_by_sap(sap);
     if (idx == -1) { printf("Student not found.\n"); return; }
+    int old_marks = st_marks[idx];
+    uint32_t old_name = st_name[idx];
 
-    printf("Current Name: %s\n", students[idx].name);
+    printf("Current Name: %s\n", student_name(idx));
     printf("Enter new name (or press Enter to keep): ");
     char newname[NAME_LEN];
     if (!fgets(newname, sizeof newname, stdin)) return;
     newname[strcspn(newname, "\n")] = '\0';
-    if (strlen(newname) > 0) safe_strdup_truncate(students[idx].name, newname, NAME_LEN);
+    if (strlen(newname) > 0) {
+        /* the old name stays in the pool until the next load */
+        uint32_t off = strpool_intern(&student_strs, newname, strlen(newname));
+        if (off == STRPOOL_NONE) { printf("Memory error.\n"); return; }
+        st_name[idx] = off;
+    }
 
-    printf("Current Marks: %d\nEnter new marks (-1 to keep): ", students[idx].marks);
-    int nm;
-    if (scanf("%d", &nm) != 1) { clear_input(); printf("Invalid input. Keeping marks.\n"); return; }
-    clear_input();
-    if (nm >= 0 && nm <= 100) students[idx].marks = nm;
-    else if (nm != -1) printf("Marks out of range; keeping old marks.\n");
+    char mk[16];
+    printf("Current Marks: %s\nEnter new marks (-1 or Enter to keep): ", format_marks(st_marks[idx], mk));
+    int nm = 0, r = read_marks(&nm);
+    if (r < 0) printf("Invalid input. Keeping marks.\n");
+    else if (r == 0 && nm >= 0 && nm <= MARKS_MAX) st_marks[idx] = nm;
+    else if (r == 0 && nm != -MARKS_SCALE) printf("Marks out of range; keeping old marks.\n");
 
+    /* the student keeps their seat; only their place in the order moves */
+    if (st_marks[idx] != old_marks || st_name[idx] != old_name) {
+        int new_marks = st_marks[idx];
+        uint32_t new_name = st_name[idx];
+        st_marks[idx] = old_marks; st_name[idx] = old_name;
+        incremental_reorder(idx, new_marks, new_name);
+        if (new_name != old_name) {
+            nameidx_remove(&name_index, idx);
+            name_index_add(idx);
+        }
+        wal_log_student(idx);
+        wal_commit();
+    }
     printf("Student updated.\n");
 }
 
+/* Take a student out of their batch in O(1): the last member fills the hole */
+static void unseat_student(int idx) {
+    int b = st_batch[idx];
+    if (b < 0) return;
+    Batch *bt = &batches[b];
+    int pos = st_member_pos[idx];
+    int last = bt->members[--bt->filled];
+    bt->members[pos] = last;
+    st_member_pos[last] = pos;
+    st_batch[idx] = -1;
+    st_member_pos[idx] = -1;
+}
+
+/* Delete the student in slot idx. O(1) apart from any incremental
+ * re-seating: nothing else is renumbered and the slot is recycled later. */
+static void remove_student(int idx) {
+    int freed_batch = st_batch[idx];
+    wal_log_delete(idx);
+    unseat_student(idx);
+    sap_index_remove(idx);
+    nameidx_remove(&name_index, idx);
+    st_gen[idx]++;
+    student_count--;
+    void *buf = free_slots;
+    if (grow_array(&buf, &free_cap, free_count + 1, sizeof(int)) == 0) {
+        free_slots = buf;
+        free_slots[free_count++] = idx;
+    }
+    incremental_remove(idx, freed_batch);
+}
+
 static void delete_student(void) {
     char sap[SAP_LEN];
     printf("Enter SAP ID to delete: ");
@@ -227,283 +914,3086 @@ static void delete_student(void) {
     sap[strcspn(sap, "\n")] = '\0';
     int idx = find_student_by_sap(sap);
     if (idx == -1) { printf("Student not found.\n"); return; }
+    remove_student(idx);
+    wal_commit();
+    printf("Student deleted.\n");
+}
 
-    /* Remove from batches */
-    for (int b = 0; b < batch_count; ++b) {
-        for (int j = 0; j < batches[b].filled; ++j) {
-            if (batches[b].members[j] == idx) {
-                for (int k = j; k < batches[b].filled - 1; ++k) batches[b].members[k] = batches[b].members[k + 1];
-                batches[b].filled--;
-                break;
-            }
-        }
-        for (int j = 0; j < batches[b].filled; ++j) {
-            if (batches[b].members[j] > idx) batches[b].members[j]--;
-        }
-    }
+/* Bulk withdrawal: delete every SAP listed in a file (first column of each
+ * line; a sap/roll header line is skipped). O(1) per student. */
+static void delete_students_from_file(void) {
+    char fname[128];
+    printf("Enter file listing SAP IDs to delete: ");
+    if (!fgets(fname, sizeof fname, stdin)) return;
+    fname[strcspn(fname, "\n")] = '\0';
+    CsvFile cf;
+    if (csv_open(fname, &cf) != 0) { printf("Could not open %s for reading.\n", fname); return; }
 
-    for (int i = idx; i < student_count - 1; ++i) students[i] = students[i + 1];
-    student_count--;
-    if (student_count == 0) {
-        free(students);
-        students = NULL;
-    } else {
-        Student *tmp = realloc(students, sizeof(Student) * student_count);
-        if (tmp) students = tmp;
+    const char *pos = cf.data, *end = cf.data + cf.size;
+    CsvField f;
+    int deleted = 0, missing = 0, first = 1;
+    while (csv_next_record(&pos, end, &f, 1) > 0) {
+        if (f.len == 0) continue;
+        if (first && (csv_field_is(&f, "sap") || csv_field_is(&f, "roll"))) { first = 0; continue; }
+        first = 0;
+        char sap[SAP_LEN];
+        csv_field_copy(&f, sap, sizeof sap);
+        int idx = find_student_by_sap(sap);
+        if (idx < 0) { missing++; continue; }
+        remove_student(idx);
+        deleted++;
     }
-    printf("Student deleted.\n");
+    csv_close(&cf);
+    wal_commit();
+    printf("Deleted %d students; %d SAP IDs not found.\n", deleted, missing);
 }
 
 /* ---------------- Batch Management ---------------- */
 
-static void add_batch(void) {
-    if (batch_count >= MAX_BATCHES) {
-        printf("Cannot add more batches (max %d).\n", MAX_BATCHES);
-        return;
-    }
+/* Append a batch; shared by the admin menu and the batch spec loader.
+ * Returns 0 on success, -1 on memory error. */
+static int append_batch(const char *name, int capacity, int course) {
     Batch b;
     memset(&b, 0, sizeof b);
+    safe_strdup_truncate(b.name, name, sizeof b.name);
+    b.capacity = capacity;
+    b.filled = 0;
+    b.course = course;
+    b.members = stats_malloc(sizeof(int) * capacity);
+    if (!b.members) return -1;
+
+    if (reserve_batches(batch_count + 1) != 0) { stats_free(b.members); return -1; }
+    batches[batch_count++] = b;
+    return 0;
+}
+
+static void free_batches(void) {
+    forget_allocation_order();
+    for (int i = 0; i < batch_count; ++i) {
+        if (batches[i].members) stats_free(batches[i].members);
+    }
+    stats_free(batches); batches = NULL; batch_count = 0; batch_cap = 0;
+}
+
+static void add_batch(void) {
+    char name[32];
     printf("Enter batch name: ");
-    if (!fgets(b.name, sizeof b.name, stdin)) return;
-    b.name[strcspn(b.name, "\n")] = '\0';
-    if (strlen(b.name) == 0) { printf("Batch name cannot be empty.\n"); return; }
+    if (!fgets(name, sizeof name, stdin)) return;
+    name[strcspn(name, "\n")] = '\0';
+    if (strlen(name) == 0) { printf("Batch name cannot be empty.\n"); return; }
 
+    int capacity;
     printf("Enter batch capacity: ");
-    if (scanf("%d", &b.capacity) != 1) { clear_input(); printf("Invalid capacity.\n"); return; }
+    if (scanf("%d", &capacity) != 1) { clear_input(); printf("Invalid capacity.\n"); return; }
     clear_input();
-    if (b.capacity <= 0) { printf("Capacity must be > 0.\n"); return; }
-
-    b.filled = 0;
-    b.members = malloc(sizeof(int) * b.capacity);
-    if (!b.members) { printf("Memory error.\n"); return; }
+    if (capacity <= 0) { printf("Capacity must be > 0.\n"); return; }
 
-    Batch *tmp = realloc(batches, sizeof(Batch) * (batch_count + 1));
-    if (!tmp) { free(b.members); printf("Memory error.\n"); return; }
-    batches = tmp;
-    batches[batch_count++] = b;
+    char course[NAME_LEN];
+    printf("Enter course served (or press Enter for any): ");
+    if (!fgets(course, sizeof course, stdin)) return;
+    course[strcspn(course, "\n")] = '\0';
+    int cid = course_id(course, strlen(course));
+    if (cid < -1 || append_batch(name, capacity, cid) != 0) { printf("Memory error.\n"); return; }
+    wal_log_batch(batch_count - 1);
+    wal_commit();
     printf("Batch added.\n");
 }
 
 static void view_batches(void) {
     if (batch_count == 0) { printf("No batches defined.\n"); return; }
     for (int i = 0; i < batch_count; ++i) {
-        printf("Batch %d: %s (%d/%d)\n", i, batches[i].name, batches[i].filled, batches[i].capacity);
+        printf("Batch %d: %s (%d/%d)", i, batches[i].name, batches[i].filled, batches[i].capacity);
+        if (batches[i].course >= 0) printf(" [%s]", course_name(batches[i].course));
+        printf("\n");
         if (batches[i].filled == 0) { printf("  (no members)\n"); continue; }
         for (int j = 0; j < batches[i].filled; ++j) {
             int si = batches[i].members[j];
-            if (si >= 0 && si < student_count)
-                printf("   %s - %s (%d)\n", students[si].sap, students[si].name, students[si].marks);
+            char mk[16];
+            if (si >= 0 && si < student_slots)
+                printf("   %s - %s (%s)\n", student_sap(si), student_name(si), format_marks(st_marks[si], mk));
         }
     }
 }
 
 /* ---------------- Allocation Helpers ---------------- */
 
-static int cmp_marks_desc(const void *a, const void *b) {
-    const Student *sa = a, *sb = b;
-    return sb->marks - sa->marks;
-}
-static int cmp_name_asc(const void *a, const void *b) {
-    const Student *sa = a, *sb = b;
-    return strcasecmp(sa->name, sb->name);
+static const char *order_name_of(int idx, void *ctx) { (void)ctx; return student_name(idx); }
+static const char *order_sap_of(int idx, void *ctx) { (void)ctx; return student_sap(idx); }
+
+/* Shared sort engine for the allocation strategies: sorts a compact
+ * (key, index) permutation instead of copying student records, with names
+ * and SAPs reduced to folded 8-byte prefixes up front. Marks skip the
+ * permutation and go straight through a counting sort.
+ * Sorts the n live slots in idxs into out (which may alias idxs). Returns 0,
+ * or -1 on memory error. Only reads student data, so partitions can be
+ * sorted concurrently. */
+static int sort_slots(OrderKind kind, const int *idxs, int n, int *out, uint64_t *comparisons) {
+    /* marks: one counting pass over the 0..100.00 range; marks outside it
+     * (hand-edited files) take the radix path below */
+    if (kind == ORDER_MARKS_DESC) {
+        int rc = order_counting_sort(idxs, n, st_marks, MARKS_MAX + 1, 1, out);
+        if (rc <= 0) return rc;
+    }
+    OrderKey *keys = stats_malloc(sizeof(OrderKey) * (n ? n : 1));
+    if (!keys) return -1;
+    OrderStrFn str_of = NULL;
+    for (int k = 0; k < n; ++k) {
+        int i = idxs[k];
+        keys[k].idx = i;
+        if (kind == ORDER_MARKS_DESC) keys[k].key = (uint64_t)(uint32_t)st_marks[i];
+        else if (kind == ORDER_SAP_ASC) keys[k].key = order_fold_prefix(student_sap(i));
+        else keys[k].key = order_fold_prefix(student_name(i));
+    }
+    if (kind == ORDER_SAP_ASC) str_of = order_sap_of;
+    else if (kind != ORDER_MARKS_DESC) str_of = order_name_of;
+
+    int descending = (kind == ORDER_MARKS_DESC || kind == ORDER_NAME_DESC);
+    if (order_sort(keys, n, descending, str_of, NULL, comparisons) != 0) { stats_free(keys); return -1; }
+    for (int k = 0; k < n; ++k) out[k] = keys[k].idx;
+    stats_free(keys);
+    return 0;
 }
-static int cmp_name_desc(const void *a, const void *b) {
-    const Student *sa = a, *sb = b;
-    return strcasecmp(sb->name, sa->name);
+
+static const char *order_kind_name(OrderKind kind) {
+    switch (kind) {
+    case ORDER_MARKS_DESC: return "marks";
+    case ORDER_NAME_ASC: return "az";
+    case ORDER_NAME_DESC: return "za";
+    case ORDER_SAP_ASC: return "sap";
+    case ORDER_RANDOM: return "random";
+    default: return "none";
+    }
 }
-static int cmp_sap_asc(const void *a, const void *b) {
-    const Student *sa = a, *sb = b;
-    return strcasecmp(sa->sap, sb->sap);
+
+/* Returns a malloc'd order of the student_count live slots, or NULL on memory error. */
+static int *build_order(OrderKind kind) {
+    PhaseMark m;
+    phase_begin(&m);
+    uint64_t cmps = 0;
+    int *order = stats_malloc(sizeof(int) * (student_count ? student_count : 1));
+    int n = 0, rc = -1;
+    if (order) {
+        for (int i = 0; i < student_slots; ++i) if (student_alive(i)) order[n++] = i;
+        rc = sort_slots(kind, order, n, order, &cmps);
+    }
+    alloc_comparisons += cmps;
+    phase_end(PHASE_SORT, &m, rc, "sort", order_kind_name(kind), (uint64_t)n, cmps);
+    if (rc != 0) { stats_free(order); return NULL; }
+    return order;
 }
 
 static void reset_allocations(void) {
-    for (int i = 0; i < student_count; ++i) students[i].allocated_batch = -1;
+    for (int i = 0; i < student_slots; ++i) { st_batch[i] = -1; st_member_pos[i] = -1; }
     for (int i = 0; i < batch_count; ++i) batches[i].filled = 0;
 }
 
-/* Round-robin allocator respecting capacities */
-static void allocate_from_order(const int *order, int order_len) {
-    reset_allocations();
-    if (order_len == 0) return;
-    int cur_batch = 0;
-    for (int oi = 0; oi < order_len; ++oi) {
-        int sidx = order[oi];
-        if (sidx < 0 || sidx >= student_count) continue;
-        int placed = 0;
-        for (int d = 0; d < batch_count; ++d) {
-            int bi = (cur_batch + d) % batch_count;
-            if (batches[bi].filled < batches[bi].capacity) {
-                batches[bi].members[batches[bi].filled++] = sidx;
-                students[sidx].allocated_batch = bi;
-                placed = 1;
-                cur_batch = (bi + 1) % batch_count;
-                break;
-            }
+static void seat_in(int sidx, int bi) {
+    st_member_pos[sidx] = batches[bi].filled;
+    batches[bi].members[batches[bi].filled++] = sidx;
+    st_batch[sidx] = bi;
+}
+
+/* Seat sidx in batch bi, or only note the batch in seats[sidx] when
+ * placing into a scratch buffer */
+static void place(int *seats, int sidx, int bi) {
+    if (seats) seats[sidx] = bi;
+    else seat_in(sidx, bi);
+}
+
+/* The open (not yet full) batches of an order-based placement, as
+ * positions 0..nb-1 in a batch list, all starting empty. Open batches sit
+ * in circular lists and a batch is unlinked when it fills, so a seat never
+ * probes full batches. Round-robin uses one list of every batch.
+ * Proportional wants the open batch with the lowest fill ratio after the
+ * next seat, (fill + 1) / capacity, first by position: batches of equal
+ * capacity then take turns in position order, so there is one list per
+ * distinct capacity and a min-heap picks between the lists. Each seat costs
+ * O(log D) for D distinct capacities, O(1) for round-robin; equal
+ * capacities give the round-robin sequence either way. */
+typedef struct {
+    int open;           /* lists with an open batch, in heap order */
+    int *cap, *fill;    /* per position */
+    int *next, *prev;   /* per position: its list, in position order */
+    int *list_of;       /* per position */
+    int *cur, *heap;    /* per list: next batch to seat; heap of open lists */
+} OpenBatches;
+
+static int open_less(const OpenBatches *ob, int a, int b) {
+    int x = ob->cur[a], y = ob->cur[b];
+    int64_t l = (int64_t)(ob->fill[x] + 1) * ob->cap[y], r = (int64_t)(ob->fill[y] + 1) * ob->cap[x];
+    return l != r ? l < r : x < y;
+}
+
+static void open_sift_down(OpenBatches *ob, int i) {
+    for (;;) {
+        int m = i, l = 2 * i + 1, r = l + 1;
+        if (l < ob->open && open_less(ob, ob->heap[l], ob->heap[m])) m = l;
+        if (r < ob->open && open_less(ob, ob->heap[r], ob->heap[m])) m = r;
+        if (m == i) return;
+        int t = ob->heap[i]; ob->heap[i] = ob->heap[m]; ob->heap[m] = t;
+        i = m;
+    }
+}
+
+static int cmp_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns 0, or -1 on memory error */
+static int open_init(OpenBatches *ob, const int *bids, int nb, int proportional) {
+    size_t m = (size_t)(nb ? nb : 1);
+    int *mem = stats_malloc(sizeof(int) * 7 * m);
+    int64_t *keys = stats_malloc(sizeof(int64_t) * m);
+    if (!mem || !keys) { stats_free(mem); stats_free(keys); return -1; }
+    *ob = (OpenBatches){ 0, mem, mem + m, mem + 2 * m, mem + 3 * m, mem + 4 * m, mem + 5 * m, mem + 6 * m };
+    int n = 0;
+    for (int k = 0; k < nb; ++k) {
+        ob->cap[k] = batches[bids ? bids[k] : k].capacity;
+        ob->fill[k] = 0;
+        if (ob->cap[k] > 0) keys[n++] = proportional ? (int64_t)ob->cap[k] << 32 | k : k;
+    }
+    if (proportional) qsort(keys, (size_t)n, sizeof keys[0], cmp_int64);
+    for (int i = 0; i < n; ++i) {
+        int k = (int)(keys[i] & 0xffffffff);
+        if (i > 0 && (!proportional || ob->cap[k] == ob->cap[ob->cur[ob->open - 1]])) {
+            int first = ob->cur[ob->open - 1], last = ob->prev[first];
+            ob->next[last] = k; ob->prev[k] = last;
+            ob->next[k] = first; ob->prev[first] = k;
+        } else {
+            ob->cur[ob->open] = k;
+            ob->heap[ob->open] = ob->open;
+            ob->open++;
+            ob->next[k] = ob->prev[k] = k;
         }
-        if (!placed) break;
+        ob->list_of[k] = ob->open - 1;
     }
+    stats_free(keys);
+    for (int i = ob->open / 2 - 1; i >= 0; --i) open_sift_down(ob, i);
+    return 0;
 }
 
-/* ---------------- Allocation Strategies ---------------- */
+/* Where the next seat goes, or -1 once every batch is full */
+static int open_next(const OpenBatches *ob) {
+    return ob->open > 0 ? ob->cur[ob->heap[0]] : -1;
+}
 
-static void allocation_by_marks(void) {
-    if (student_count == 0 || batch_count == 0) { printf("Need students and batches to allocate.\n"); return; }
-    Student *copy = malloc(sizeof(Student) * student_count);
-    if (!copy) { printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) copy[i] = students[i];
-    qsort(copy, student_count, sizeof(Student), cmp_marks_desc);
-    int *order = malloc(sizeof(int) * student_count);
-    if (!order) { free(copy); printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) order[i] = find_student_by_sap(copy[i].sap);
-    allocate_from_order(order, student_count);
-    free(order); free(copy);
-    printf("Marks-based allocation completed.\n");
-}
-
-static void allocation_alphabetical(int reverse) {
-    if (student_count == 0 || batch_count == 0) { printf("Need students and batches to allocate.\n"); return; }
-    Student *copy = malloc(sizeof(Student) * student_count);
-    if (!copy) { printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) copy[i] = students[i];
-    qsort(copy, student_count, sizeof(Student), reverse ? cmp_name_desc : cmp_name_asc);
-    int *order = malloc(sizeof(int) * student_count);
-    if (!order) { free(copy); printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) order[i] = find_student_by_sap(copy[i].sap);
-    allocate_from_order(order, student_count);
-    free(order); free(copy);
-    printf("Alphabetical allocation %scompleted.\n", reverse ? "reverse " : "");
-}
-
-static void allocation_by_sap_asc(void) {
-    if (student_count == 0 || batch_count == 0) { printf("Need students and batches to allocate.\n"); return; }
-    Student *copy = malloc(sizeof(Student) * student_count);
-    if (!copy) { printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) copy[i] = students[i];
-    qsort(copy, student_count, sizeof(Student), cmp_sap_asc);
-    int *order = malloc(sizeof(int) * student_count);
-    if (!order) { free(copy); printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) order[i] = find_student_by_sap(copy[i].sap);
-    allocate_from_order(order, student_count);
-    free(order); free(copy);
-    printf("SAP ascending allocation completed.\n");
-}
-
-static void allocation_random(void) {
-    if (student_count == 0 || batch_count == 0) { printf("Need students and batches to allocate.\n"); return; }
-    int *idxs = malloc(sizeof(int) * student_count);
-    if (!idxs) { printf("Memory error.\n"); return; }
-    for (int i = 0; i < student_count; ++i) idxs[i] = i;
-    for (int i = student_count - 1; i > 0; --i) {
-        int j = rand() % (i + 1);
-        int t = idxs[i]; idxs[i] = idxs[j]; idxs[j] = t;
-    }
-    allocate_from_order(idxs, student_count);
-    free(idxs);
-    printf("Random allocation completed.\n");
+/* Fill the seat open_next gave, at position k */
+static void open_take(OpenBatches *ob, int k) {
+    int g = ob->list_of[k];
+    ob->cur[g] = ob->next[k];
+    if (++ob->fill[k] == ob->cap[k]) {
+        if (ob->next[k] == k) ob->heap[0] = ob->heap[--ob->open];
+        ob->next[ob->prev[k]] = ob->next[k];
+        ob->prev[ob->next[k]] = ob->prev[k];
+    }
+    open_sift_down(ob, 0);
 }
 
-/* ---------------- CSV Save/Load ---------------- */
+static void open_free(OpenBatches *ob) {
+    stats_free(ob->cap);
+}
 
-static void save_csv(const char *filename) {
-    if (!filename) return;
-    FILE *f = fopen(filename, "w");
-    if (!f) { printf("Could not open %s for writing.\n", filename); return; }
-    fprintf(f, "sap,name,marks,allocated_batch\n");
-    for (int i = 0; i < student_count; ++i) {
-        char namecopy[NAME_LEN];
-        strncpy(namecopy, students[i].name, NAME_LEN-1); namecopy[NAME_LEN-1] = '\0';
-        for (char *p = namecopy; *p; ++p) if (*p == ',') *p = ' ';
-        fprintf(f, "%s,%s,%d,%d\n", students[i].sap, namecopy, students[i].marks, students[i].allocated_batch);
+/* Seat order over the nb batches listed in bids (all batches when NULL),
+ * round-robin or in proportion to capacity (proportional_placement),
+ * until the batches are full. With seats, the batches are written there
+ * (see place) and nothing live changes. Returns 0, or -1 on memory error. */
+static int seat_in_order(const int *order, int order_len, const int *bids, int nb, int *seats) {
+    OpenBatches ob;
+    if (open_init(&ob, bids, nb, proportional_placement) != 0) return -1;
+    for (int oi = 0, k; oi < order_len && (k = open_next(&ob)) >= 0; ++oi) {
+        int sidx = order[oi];
+        if (sidx < 0 || sidx >= student_slots || !student_alive(sidx)) continue;
+        place(seats, sidx, bids ? bids[k] : k);
+        open_take(&ob, k);
     }
-    fclose(f);
-    printf("Saved %d students to %s\n", student_count, filename);
+    open_free(&ob);
+    return 0;
+}
+
+static int allocate_from_order(const int *order, int order_len) {
+    reset_allocations();
+    if (seat_in_order(order, order_len, NULL, batch_count, NULL) == 0) return 0;
+    forget_allocation_order();
+    return -1;
 }
 
-static void load_csv(const char *filename) {
-    if (!filename) return;
-    FILE *f = fopen(filename, "r");
-    if (!f) { printf("Could not open %s for reading.\n", filename); return; }
+/* Min-heap of open batches (positions in the batch list) keyed on mark sum
+ * per quota seat */
+typedef struct {
+    int *h;
+    int n;
+    const int64_t *sum;
+    const int *quota;
+    uint64_t cmps;
+} BalanceHeap;
 
-    char line[MAX_LINE_LEN];
-    if (!fgets(line, sizeof line, f)) { fclose(f); return; }
+static int balance_less(BalanceHeap *bh, int a, int b) {
+    bh->cmps++;
+    int64_t l = bh->sum[a] * bh->quota[b], r = bh->sum[b] * bh->quota[a];
+    return l != r ? l < r : a < b;
+}
 
-    for (int i = 0; i < batch_count; ++i) {
-        if (batches[i].members) free(batches[i].members);
+static void balance_sift_down(BalanceHeap *bh, int i) {
+    for (;;) {
+        int m = i, l = 2 * i + 1, r = l + 1;
+        if (l < bh->n && balance_less(bh, bh->h[l], bh->h[m])) m = l;
+        if (r < bh->n && balance_less(bh, bh->h[r], bh->h[m])) m = r;
+        if (m == i) return;
+        int t = bh->h[i]; bh->h[i] = bh->h[m]; bh->h[m] = t;
+        i = m;
+    }
+}
+
+/* Balanced placement of a descending-marks order over the nb batches in
+ * bids (all when NULL): each batch gets a quota proportional to its
+ * capacity, and each student goes to the open batch whose mark sum per
+ * quota seat is lowest. The top students spread out like a snake draft and
+ * the batch means converge. O(n log B). Heap comparisons are added to
+ * *comparisons; seats is as for seat_in_order. Returns 0, or -1 on memory
+ * error. */
+static int seat_balanced(const int *order, int n, const int *bids, int nb, uint64_t *comparisons, int *seats) {
+    if (nb == 0) return 0;
+    int *quota = stats_malloc(sizeof(int) * 2 * nb);   /* quota, then seats taken, per batch */
+    int *heap = stats_malloc(sizeof(int) * nb);
+    int64_t *sum = stats_calloc((size_t)nb, sizeof(int64_t));
+    if (!quota || !heap || !sum) { stats_free(quota); stats_free(heap); stats_free(sum); return -1; }
+    int *took = quota + nb;
+
+    /* Seat min(n, capacity) students, split across batches by capacity */
+    int64_t cap = 0;
+    for (int k = 0; k < nb; ++k) cap += batches[bids ? bids[k] : k].capacity;
+    int to_seat = cap < n ? (int)cap : n;
+    int given = 0;
+    for (int k = 0; k < nb; ++k) {
+        quota[k] = cap ? (int)((int64_t)to_seat * batches[bids ? bids[k] : k].capacity / cap) : 0;
+        took[k] = 0;
+        given += quota[k];
+    }
+    for (int k = 0; given < to_seat; k = (k + 1) % nb) {
+        if (quota[k] < batches[bids ? bids[k] : k].capacity) { quota[k]++; given++; }
     }
-    free(batches); batches = NULL; batch_count = 0;
 
-    free(students); students = NULL; student_count = 0;
+    BalanceHeap bh = { heap, 0, sum, quota, 0 };
+    for (int k = 0; k < nb; ++k) if (quota[k] > 0) heap[bh.n++] = k;
+    for (int i = bh.n / 2 - 1; i >= 0; --i) balance_sift_down(&bh, i);
 
-    while (fgets(line, sizeof line, f)) {
-        char *p = strtok(line, ",\n");
-        if (!p) continue;
-        Student st; memset(&st, 0, sizeof st);
-        strncpy(st.sap, p, SAP_LEN-1);
-        p = strtok(NULL, ",\n");
-        if (p) strncpy(st.name, p, NAME_LEN-1);
-        p = strtok(NULL, ",\n");
-        if (p) st.marks = atoi(p);
-        p = strtok(NULL, ",\n");
-        if (p) st.allocated_batch = atoi(p);
-        else st.allocated_batch = -1;
-        Student *tmp = realloc(students, sizeof(Student) * (student_count + 1));
-        if (!tmp) { printf("Memory error while loading.\n"); break; }
-        students = tmp;
-        students[student_count++] = st;
+    for (int oi = 0; oi < n && bh.n > 0; ++oi) {
+        int sidx = order[oi], k = heap[0];
+        place(seats, sidx, bids ? bids[k] : k);
+        sum[k] += st_marks[sidx];
+        if (++took[k] == quota[k]) heap[0] = heap[--bh.n];
+        balance_sift_down(&bh, 0);
     }
-    fclose(f);
-    printf("Loaded %d students from %s\n", student_count, filename);
+    stats_free(quota); stats_free(heap); stats_free(sum);
+    *comparisons += bh.cmps;
+    return 0;
 }
 
-/* ---------------- Student Access ---------------- */
+/* ---------------- Random Allocation ---------------- */
 
-static void student_access(void) {
-    char sap[SAP_LEN];
-    printf("Enter SAP ID: ");
-    if (!fgets(sap, sizeof sap, stdin)) return;
-    sap[strcspn(sap, "\n")] = '\0';
-    int idx = find_student_by_sap(sap);
-    if (idx == -1) { printf("Student not found.\n"); return; }
-    printf("SAP: %s\nName: %s\nMarks: %d\n", students[idx].sap, students[idx].name, students[idx].marks);
-    int b = students[idx].allocated_batch;
-    if (b >= 0 && b < batch_count) printf("Allocated Batch: %s (index %d)\n", batches[b].name, b);
-    else printf("Allocated Batch: Not allocated\n");
+/* The seed the next random allocation will use, drawn now if none is set */
+static uint64_t peek_random_seed(void) {
+    if (!random_seeded) { random_next_seed = rng_fresh_seed(); random_seeded = 1; }
+    return random_next_seed;
 }
 
-/* ---------------- Admin Menu ---------------- */
+/* The seed for the random allocation about to run, recorded for the
+ * Summary Report. The next run gets a new seed drawn from this one. */
+static uint64_t take_random_seed(int trials) {
+    uint64_t seed = peek_random_seed();
+    Rng r;
+    rng_seed(&r, seed, UINT64_MAX - 1);
+    random_next_seed = rng_next(&r);
+    random_last = (RandomRun){ 1, seed, trials, proportional_placement, 0, 0, 0 };
+    return seed;
+}
 
-static void admin_menu(void) {
-    for (;;) {
-        printf("\n--- Admin Menu ---\n");
-        printf("1. Add student(s)\n2. View students\n3. Update student\n4. Delete student\n");
-        printf("5. Add batch\n6. View batches\n7. Allocate batches\n8. Save database to CSV\n");
-        printf("9. Load database from CSV\n10. Summary Report\n11. Back to Main Menu\n");
-        printf("Choose option: ");
-        int ch;
-        if (scanf("%d", &ch) != 1) { clear_input(); continue; }
-        clear_input();
-        if (ch == 1) add_student_interactive();
-        else if (ch == 2) view_students();
-        else if (ch == 3) update_student();
-        else if (ch == 4) delete_student();
-        else if (ch == 5) add_batch();
-        else if (ch == 6) view_batches();
-        else if (ch == 7) {
-            if (batch_count == 0) { printf("No batches defined. Add batches first.\n"); continue; }
-            if (student_count == 0) { printf("No students available to allocate.\n"); continue; }
-            printf("Choose allocation strategy:\n1. Marks (High->Low)\n2. A->Z\n3. Z->A\n4. SAP asc\n5. Random\nSelect: ");
-            int s;
-            if (scanf("%d", &s) != 1) { clear_input(); continue; }
-            clear_input();
-            if (s == 1) allocation_by_marks();
-            else if (s == 2) allocation_alphabetical(0);
-            else if (s == 3) allocation_alphabetical(1);
-            else if (s == 4) allocation_by_sap_asc();
-            else if (s == 5) allocation_random();
-            else printf("Invalid strategy.\n");
-        }
-        else if (ch == 8) {
-            char fname[128];
+/* Fisher-Yates */
+static void shuffle_slots(Rng *r, int *a, int n) {
+    for (int i = n - 1; i > 0; --i) {
+        int j = (int)rng_below(r, (uint32_t)i + 1);
+        int t = a[i]; a[i] = a[j]; a[j] = t;
+    }
+}
+
+/* Monte Carlo: trial k shuffles with stream k of the seed, so the winner
+ * can be replayed from (seed, trials) alone */
+typedef struct {
+    const int *slots;     /* live students, in slot order */
+    int n;
+    uint64_t seed;
+    double marks_var;     /* over every student */
+    double *score;        /* per trial */
+    int *best;            /* best order so far; guarded by lock */
+    int best_trial;
+    double best_score;
+    int failed;
+    pthread_mutex_t lock;
+} RandomTrials;
+
+/* Score the placement seat_in_order would make from order, without
+ * seating anyone. Each term is normalised so that a typical shuffle scores
+ * about 1: the variance of the batch mark means over what sampling alone
+ * gives, and the chi-square statistic of the course mix over its degrees
+ * of freedom. Lower is better. ob is a fresh open_init over every batch;
+ * sum and mix are zeroed scratch of batch_count and (batch_count + 1) *
+ * (course_count + 1). */
+static double score_placement(const RandomTrials *rt, const int *order, OpenBatches *ob, int64_t *sum, int *mix) {
+    int nb = batch_count, nc = course_count + 1;
+    const int *filled = ob->fill;
+    for (int oi = 0, k; oi < rt->n && (k = open_next(ob)) >= 0; ++oi) {
+        int sidx = order[oi];
+        sum[k] += st_marks[sidx];
+        mix[k * nc + (st_course[sidx] >= 0 ? st_course[sidx] : course_count)]++;
+        open_take(ob, k);
+    }
+
+    int used = 0, seated = 0, *total = mix + (size_t)nb * nc;
+    double msum = 0, msq = 0;
+    for (int b = 0; b < nb; ++b) {
+        if (filled[b] == 0) continue;
+        double mean = (double)sum[b] / filled[b];
+        msum += mean; msq += mean * mean;
+        used++;
+        seated += filled[b];
+        for (int c = 0; c < nc; ++c) total[c] += mix[b * nc + c];
+    }
+    if (used < 2) return 0;
+    double spread = msq / used - (msum / used) * (msum / used);
+    double sampling = rt->marks_var / ((double)seated / used);
+    double score = sampling > 0 ? spread / sampling : 0;
+
+    double chi2 = 0;
+    int courses = 0;
+    for (int c = 0; c < nc; ++c) courses += total[c] > 0;
+    for (int b = 0; b < nb && courses > 1; ++b) {
+        for (int c = 0; c < nc; ++c) {
+            if (total[c] == 0) continue;
+            double e = (double)filled[b] * total[c] / seated, o = mix[b * nc + c];
+            if (e > 0) chi2 += (o - e) * (o - e) / e;
+        }
+    }
+    if (courses > 1) score += chi2 / ((double)(courses - 1) * (used - 1));
+    return score;
+}
+
+static void random_trial_task(int k, void *ctx) {
+    RandomTrials *rt = ctx;
+    int nb = batch_count, nc = course_count + 1;
+    int *order = stats_malloc(sizeof(int) * (size_t)(rt->n ? rt->n : 1));
+    int64_t *sum = stats_calloc((size_t)nb, sizeof(int64_t));
+    int *mix = stats_calloc((size_t)(nb + 1) * nc, sizeof(int));
+    OpenBatches ob = { 0 };
+    if (!order || !sum || !mix || open_init(&ob, NULL, nb, proportional_placement) != 0) {
+        pthread_mutex_lock(&rt->lock);
+        rt->failed = 1;
+        pthread_mutex_unlock(&rt->lock);
+        stats_free(order); stats_free(sum); stats_free(mix);
+        return;
+    }
+    memcpy(order, rt->slots, sizeof(int) * (size_t)rt->n);
+    Rng r;
+    rng_seed(&r, rt->seed, (uint64_t)k);
+    shuffle_slots(&r, order, rt->n);
+    double score = score_placement(rt, order, &ob, sum, mix);
+    rt->score[k] = score;
+
+    /* ties go to the lower trial, so the winner does not depend on timing */
+    pthread_mutex_lock(&rt->lock);
+    if (!rt->best || score < rt->best_score || (score == rt->best_score && k < rt->best_trial)) {
+        int *t = rt->best; rt->best = order; order = t;
+        rt->best_trial = k;
+        rt->best_score = score;
+    }
+    pthread_mutex_unlock(&rt->lock);
+    stats_free(order); stats_free(sum); stats_free(mix);
+    open_free(&ob);
+}
+
+/* Shuffle the roster trials times in parallel from seed and return the
+ * best-balanced order (student_count slots), or NULL on memory error. The
+ * winner and the scores go in run. */
+static int *best_random_order(uint64_t seed, int trials, RandomRun *run) {
+    RandomTrials rt;
+    memset(&rt, 0, sizeof rt);
+    int *slots = stats_malloc(sizeof(int) * (size_t)(student_count ? student_count : 1));
+    rt.score = stats_malloc(sizeof(double) * (size_t)trials);
+    if (!slots || !rt.score) { stats_free(slots); stats_free(rt.score); return NULL; }
+    double msum = 0, msq = 0;
+    for (int i = 0; i < student_slots; ++i) {
+        if (!student_alive(i)) continue;
+        slots[rt.n++] = i;
+        msum += st_marks[i]; msq += (double)st_marks[i] * st_marks[i];
+    }
+    rt.slots = slots;
+    rt.marks_var = rt.n ? msq / rt.n - (msum / rt.n) * (msum / rt.n) : 0;
+    rt.seed = seed;
+    pthread_mutex_init(&rt.lock, NULL);
+    pool_run(trials, pool_default_threads(), random_trial_task, &rt);
+    pthread_mutex_destroy(&rt.lock);
+
+    if (rt.failed) { stats_free(rt.best); rt.best = NULL; }
+    double mean = 0;
+    for (int k = 0; k < trials; ++k) mean += rt.score[k];
+    run->best = rt.best_trial;
+    run->score = rt.best_score;
+    run->mean_score = mean / trials;
+    stats_free(slots);
+    stats_free(rt.score);
+    return rt.best;
+}
+
+/* ---------------- Per-course Partitioning ---------------- */
+
+/* Students of partition p are slots[sstart[p] .. sstart[p + 1]), in slot
+ * order, and its batches are bids[bstart[p] .. bstart[p + 1]). Partition
+ * c < course_count is course c; the last one holds untagged batches plus
+ * every student without a course or whose course has no batch of its own. */
+typedef struct {
+    int np;
+    int *sstart, *bstart;   /* np + 1 each */
+    int *slots, *bids;
+} CourseSplit;
+
+static int course_partition_of(const CourseSplit *cs, int sidx) {
+    int c = st_course[sidx];
+    return c >= 0 && cs->bstart[c + 1] > cs->bstart[c] ? c : course_count;
+}
+
+static void course_split_free(CourseSplit *cs) {
+    stats_free(cs->sstart); stats_free(cs->bstart); stats_free(cs->slots); stats_free(cs->bids);
+}
+
+/* Returns 0, or -1 on memory error */
+static int course_split(CourseSplit *cs) {
+    int np = course_count + 1;
+    cs->np = np;
+    cs->sstart = stats_calloc((size_t)np + 1, sizeof(int));
+    cs->bstart = stats_calloc((size_t)np + 1, sizeof(int));
+    cs->slots = stats_malloc(sizeof(int) * (student_count ? student_count : 1));
+    cs->bids = stats_malloc(sizeof(int) * (batch_count ? batch_count : 1));
+    int *cursor = stats_malloc(sizeof(int) * np);
+    if (!cs->sstart || !cs->bstart || !cs->slots || !cs->bids || !cursor) {
+        course_split_free(cs);
+        stats_free(cursor);
+        return -1;
+    }
+    int *sstart = cs->sstart, *bstart = cs->bstart;
+    for (int b = 0; b < batch_count; ++b) bstart[(batches[b].course >= 0 ? batches[b].course : course_count) + 1]++;
+    for (int p = 0; p < np; ++p) bstart[p + 1] += bstart[p];
+    for (int i = 0; i < student_slots; ++i) if (student_alive(i)) sstart[course_partition_of(cs, i) + 1]++;
+    for (int p = 0; p < np; ++p) sstart[p + 1] += sstart[p];
+
+    for (int p = 0; p < np; ++p) cursor[p] = bstart[p];
+    for (int b = 0; b < batch_count; ++b) cs->bids[cursor[batches[b].course >= 0 ? batches[b].course : course_count]++] = b;
+    for (int p = 0; p < np; ++p) cursor[p] = sstart[p];
+    for (int i = 0; i < student_slots; ++i) if (student_alive(i)) cs->slots[cursor[course_partition_of(cs, i)]++] = i;
+    stats_free(cursor);
+    return 0;
+}
+
+/* Shuffle each partition of slots (laid out like cs->slots) with stream
+ * p of seed, as per-course random allocation seats them */
+static void course_split_shuffle(const CourseSplit *cs, int *slots, uint64_t seed) {
+    for (int p = 0; p < cs->np; ++p) {
+        Rng r;
+        rng_seed(&r, seed, (uint64_t)p);
+        shuffle_slots(&r, slots + cs->sstart[p], cs->sstart[p + 1] - cs->sstart[p]);
+    }
+}
+
+typedef struct {
+    OrderKind kind;
+    int balanced;
+    int *slots;
+    const int *sstart;
+    const int *bids;
+    const int *bstart;
+    char *failed;
+    double *sort_secs;      /* per partition, for the Summary Report */
+    uint64_t *sort_cmps;
+    uint64_t *seat_cmps;
+} CoursePlan;
+
+static void course_task(int p, void *ctx) {
+    CoursePlan *plan = ctx;
+    int *seg = plan->slots + plan->sstart[p];
+    int n = plan->sstart[p + 1] - plan->sstart[p];
+    const int *bids = plan->bids + plan->bstart[p];
+    int nb = plan->bstart[p + 1] - plan->bstart[p];
+    if (n == 0 || nb == 0) return;
+    double t0 = stats_now();
+    if (plan->kind != ORDER_RANDOM && sort_slots(plan->kind, seg, n, seg, &plan->sort_cmps[p]) != 0) { plan->failed[p] = 1; return; }
+    plan->sort_secs[p] = stats_now() - t0;
+    if (plan->balanced) plan->failed[p] = seat_balanced(seg, n, bids, nb, &plan->seat_cmps[p], NULL) != 0;
+    else plan->failed[p] = seat_in_order(seg, n, bids, nb, NULL) != 0;
+}
+
+/* Run a strategy on every course partition independently. Partitions
+ * touch disjoint students and batches, so they run on the worker pool. A
+ * course whose batches fill up leaves the rest of its students unseated. */
+static int allocate_by_course(OrderKind kind, int balanced, const char *what) {
+    int np = course_count + 1;
+    CourseSplit cs = { 0 };
+    char *failed = stats_calloc((size_t)np, 1);
+    double *sort_secs = stats_calloc((size_t)np, sizeof(double));
+    uint64_t *cmps = stats_calloc((size_t)np * 2, sizeof(uint64_t));
+    int rc = -1, split = 0;
+    if (!failed || !sort_secs || !cmps || !(split = course_split(&cs) == 0)) {
+        report_error("Memory error.\n");
+        goto done;
+    }
+
+    /* shuffle up front, one stream per partition so the seed replays it */
+    if (kind == ORDER_RANDOM) course_split_shuffle(&cs, cs.slots, take_random_seed(1));
+
+    reset_allocations();
+    CoursePlan plan = { kind, balanced, cs.slots, cs.sstart, cs.bids, cs.bstart, failed, sort_secs, cmps, cmps + np };
+    int threads = pool_default_threads();
+    PhaseMark m;
+    phase_begin(&m);
+    pool_run(np, threads, course_task, &plan);
+
+    /* the sort phase is the partitions' sorting time summed over threads */
+    double secs = 0;
+    uint64_t sort_cmps = 0;
+    rc = 0;
+    for (int p = 0; p < np; ++p) {
+        if (failed[p]) rc = -1;
+        secs += sort_secs[p];
+        sort_cmps += cmps[p];
+        alloc_comparisons += cmps[p] + cmps[np + p];
+    }
+    m.t0 = stats_now() - secs;
+    phase_end(PHASE_SORT, &m, rc, "sort", kind == ORDER_RANDOM ? "random (shuffled up front)" : order_kind_name(kind),
+              (uint64_t)student_count, sort_cmps);
+    if (rc != 0) { reset_allocations(); report_error("Memory error.\n"); goto done; }
+    report("%s allocation completed per course (%d courses, %d threads).\n", what, course_count, threads < np ? threads : np);
+    if (incremental_alloc) report("Incremental maintenance does not apply to per-course allocation.\n");
+    if (kind == ORDER_RANDOM) {
+        report("Seed %llu.%s\n", (unsigned long long)random_last.seed,
+               random_trials > 1 ? " Shuffles are not compared per course; each course gets one." : "");
+    }
+done:
+    /* placement follows several independent orders; incremental maintenance
+     * needs a single one */
+    forget_allocation_order();
+    if (split) course_split_free(&cs);
+    stats_free(failed); stats_free(sort_secs); stats_free(cmps);
+    return rc;
+}
+
+/* ---------------- Allocation Strategies ---------------- */
+
+static int allocation_by_marks(void) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (course_partitioned) return allocate_by_course(ORDER_MARKS_DESC, 0, "Marks-based");
+    int *order = build_order(ORDER_MARKS_DESC);
+    if (!order) { report_error("Memory error.\n"); return -1; }
+    if (allocate_from_order(order, student_count) != 0) { stats_free(order); report_error("Memory error.\n"); return -1; }
+    remember_order(ORDER_MARKS_DESC, order);
+    report("Marks-based allocation completed.\n");
+    return 0;
+}
+
+static int allocation_alphabetical(int reverse) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (course_partitioned) return allocate_by_course(reverse ? ORDER_NAME_DESC : ORDER_NAME_ASC, 0, "Alphabetical");
+    int *order = build_order(reverse ? ORDER_NAME_DESC : ORDER_NAME_ASC);
+    if (!order) { report_error("Memory error.\n"); return -1; }
+    if (allocate_from_order(order, student_count) != 0) { stats_free(order); report_error("Memory error.\n"); return -1; }
+    remember_order(reverse ? ORDER_NAME_DESC : ORDER_NAME_ASC, order);
+    report("Alphabetical allocation %scompleted.\n", reverse ? "reverse " : "");
+    return 0;
+}
+
+static int allocation_by_sap_asc(void) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (course_partitioned) return allocate_by_course(ORDER_SAP_ASC, 0, "SAP ascending");
+    int *order = build_order(ORDER_SAP_ASC);
+    if (!order) { report_error("Memory error.\n"); return -1; }
+    if (allocate_from_order(order, student_count) != 0) { stats_free(order); report_error("Memory error.\n"); return -1; }
+    remember_order(ORDER_SAP_ASC, order);
+    report("SAP ascending allocation completed.\n");
+    return 0;
+}
+
+static int allocation_random(void) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (course_partitioned) return allocate_by_course(ORDER_RANDOM, 0, "Random");
+    int *idxs = NULL;
+    if (random_trials > 1) idxs = best_random_order(take_random_seed(random_trials), random_trials, &random_last);
+    if (random_trials <= 1) {
+        idxs = stats_malloc(sizeof(int) * student_count);
+        if (!idxs) { report_error("Memory error.\n"); return -1; }
+        int n = 0;
+        for (int i = 0; i < student_slots; ++i) if (student_alive(i)) idxs[n++] = i;
+        Rng r;
+        rng_seed(&r, take_random_seed(1), 0);
+        shuffle_slots(&r, idxs, n);
+    }
+    if (!idxs) { report_error("Memory error.\n"); return -1; }
+    if (allocate_from_order(idxs, student_count) != 0) { stats_free(idxs); report_error("Memory error.\n"); return -1; }
+    remember_order(ORDER_RANDOM, idxs);
+    rng_seed(&order_rng, random_last.seed, UINT64_MAX);
+    if (random_last.trials > 1)
+        report("Random allocation completed: best of %d shuffles (trial %d, score %.3f; mean %.3f), seed %llu.\n",
+               random_last.trials, random_last.best, random_last.score, random_last.mean_score,
+               (unsigned long long)random_last.seed);
+    else report("Random allocation completed, seed %llu.\n", (unsigned long long)random_last.seed);
+    return 0;
+}
+
+/* Balanced marks: even out the mean marks across batches instead of the
+ * round-robin's top-heavy skew (see seat_balanced) */
+static int allocation_balanced(void) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (course_partitioned) {
+        if (allocate_by_course(ORDER_MARKS_DESC, 1, "Balanced marks") != 0) return -1;
+    } else {
+        int *order = build_order(ORDER_MARKS_DESC);
+        reset_allocations();
+        if (!order || seat_balanced(order, student_count, NULL, batch_count, &alloc_comparisons, NULL) != 0) {
+            stats_free(order);
+            reset_allocations();
+            report_error("Memory error.\n");
+            return -1;
+        }
+        stats_free(order);
+        /* Placement is not a function of position in a sorted order, so
+         * there is nothing for incremental maintenance to follow */
+        forget_allocation_order();
+        report("Balanced marks allocation completed.\n");
+        if (incremental_alloc) report("Incremental maintenance does not apply to balanced allocation.\n");
+    }
+    report_batch_balance();
+    return 0;
+}
+
+typedef struct {
+    uint32_t name;  /* offset in pref_strs */
+    int batch;
+} PrefBatch;
+
+static int cmp_pref_batch(const void *a, const void *b) {
+    const PrefBatch *x = a, *y = b;
+    if (x->name != y->name) return x->name < y->name ? -1 : 1;
+    return x->batch - y->batch;
+}
+
+/* First batch with the given name in the sorted table, or -1 */
+static int pref_batch_lookup(const PrefBatch *names, int n, uint32_t name) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (names[mid].name < name) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < n && names[lo].name == name ? names[lo].batch : -1;
+}
+
+/* Preferences: seat as many students as capacity allows while minimising
+ * the total rank of the batches they get, as a min-cost flow
+ *
+ *   source -> student -> listed batch (cost = rank, 0 for first choice)
+ *                     -> hub -> any batch (cost = longest list, i.e. worse
+ *                                          than every listed choice)
+ *   batch -> sink (capacity)
+ *
+ * With per-course allocation each course gets its own hub and students may
+ * only use batches of their own partition. Ranks are small integers, so
+ * the solver needs only a handful of phases even at 100k students. */
+static int allocation_by_preference(void) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to allocate.\n"); return -1; }
+    if (pref_records == 0) { report_error("Load batch preferences first.\n"); return -1; }
+
+    int np = course_partitioned ? course_count + 1 : 1;
+    int n = student_count, B = batch_count;
+    int hub0 = 2, batch0 = hub0 + np, student0 = batch0 + B;
+    int *slots = stats_malloc(sizeof(int) * n);
+    int *pref_of = stats_malloc(sizeof(int) * student_slots);  /* slot -> record, or -1 */
+    int *first_arc = stats_malloc(sizeof(int) * n);
+    int *hub_arc = stats_malloc(sizeof(int) * n);
+    int *part = stats_malloc(sizeof(int) * n);
+    int *bpart = stats_malloc(sizeof(int) * B);
+    int *hub_batch_arc = stats_malloc(sizeof(int) * B);
+    char *tagged = stats_calloc((size_t)course_count + 1, 1);
+    PrefBatch *names = stats_malloc(sizeof(PrefBatch) * B);
+    McfGraph g;
+    int rc = -1, graph = 0;
+    if (!slots || !pref_of || !first_arc || !hub_arc || !part || !bpart || !hub_batch_arc || !tagged || !names) goto oom;
+
+    /* batch names -> indices, through the preference file's interned names */
+    for (int b = 0; b < B; ++b) {
+        names[b].name = strpool_intern(&pref_strs, batches[b].name, strlen(batches[b].name));
+        names[b].batch = b;
+        if (names[b].name == STRPOOL_NONE) goto oom;
+        if (batches[b].course >= 0) tagged[batches[b].course] = 1;
+        bpart[b] = course_partitioned && batches[b].course >= 0 ? batches[b].course : np - 1;
+    }
+    qsort(names, (size_t)B, sizeof names[0], cmp_pref_batch);
+
+    for (int i = 0; i < student_slots; ++i) pref_of[i] = -1;
+    int unknown = 0, k_max = 0;
+    for (int r = 0; r < pref_items_len; r += 2 + (int)pref_items[r + 1]) {
+        int idx = find_student_by_sap(strpool_get(&pref_strs, pref_items[r]));
+        if (idx < 0) { unknown++; continue; }
+        if (pref_of[idx] < 0) pref_of[idx] = r;
+        if ((int)pref_items[r + 1] > k_max) k_max = (int)pref_items[r + 1];
+    }
+    n = 0;
+    for (int i = 0; i < student_slots; ++i) {
+        if (!student_alive(i)) continue;
+        int c = st_course[i];
+        part[n] = course_partitioned && c >= 0 && tagged[c] ? c : np - 1;
+        slots[n++] = i;
+    }
+
+    if (mcf_init(&g, student0 + n, n * (k_max / 2 + 3) + 2 * B) != 0) goto oom;
+    graph = 1;
+    int bad = 0;
+    for (int k = 0; k < n; ++k) {
+        int i = slots[k], v = student0 + k;
+        if (mcf_add_arc(&g, 0, v, 1, 0) < 0) goto oom;
+        first_arc[k] = g.arcs;
+        int r = pref_of[i], cnt = r < 0 ? 0 : (int)pref_items[r + 1];
+        for (int j = 0; j < cnt; ++j) {
+            int b = pref_batch_lookup(names, B, pref_items[r + 2 + j]);
+            if (b < 0 || bpart[b] != part[k]) { bad++; continue; }
+            if (mcf_add_arc(&g, v, batch0 + b, 1, j) < 0) goto oom;
+        }
+        if ((hub_arc[k] = mcf_add_arc(&g, v, hub0 + part[k], 1, k_max)) < 0) goto oom;
+    }
+    for (int b = 0; b < B; ++b) {
+        if ((hub_batch_arc[b] = mcf_add_arc(&g, hub0 + bpart[b], batch0 + b, n, 0)) < 0) goto oom;
+        if (mcf_add_arc(&g, batch0 + b, 1, batches[b].capacity, 0) < 0) goto oom;
+    }
+    int64_t flow, cost;
+    if (mcf_solve(&g, 0, 1, &flow, &cost) != 0) goto oom;
+
+    /* Listed choices seat directly; hub students fill each batch's hub flow
+     * in slot order */
+    int hist[4] = {0}, outside = 0;
+    reset_allocations();
+    for (int k = 0; k < n; ++k) {
+        for (int a = first_arc[k]; a < hub_arc[k]; a += 2) {
+            if (!mcf_flow(&g, a)) continue;
+            seat_in(slots[k], g.to[a] - batch0);
+            hist[g.cost[a] < 3 ? g.cost[a] : 3]++;
+        }
+    }
+    for (int p = 0; p < np; ++p) {
+        int k = 0;
+        for (int b = 0; b < B; ++b) {
+            if (bpart[b] != p) continue;
+            for (int f = mcf_flow(&g, hub_batch_arc[b]); f > 0; --f) {
+                while (!(part[k] == p && mcf_flow(&g, hub_arc[k]))) k++;
+                seat_in(slots[k++], b);
+                outside++;
+            }
+        }
+    }
+    forget_allocation_order();
+    report("Preference allocation completed: %d first choice, %d second, %d third, %d lower, "
+           "%d outside their list, %d unseated.\n", hist[0], hist[1], hist[2], hist[3], outside, n - (int)flow);
+    if (unknown > 0) report("Ignored preferences for %d unknown SAP IDs.\n", unknown);
+    if (bad > 0) report("Ignored %d choices naming unknown batches%s.\n", bad, course_partitioned ? " or other courses' batches" : "");
+    if (incremental_alloc) report("Incremental maintenance does not apply to preference allocation.\n");
+    rc = 0;
+    goto done;
+oom:
+    report_error("Memory error.\n");
+done:
+    if (graph) mcf_free(&g);
+    stats_free(slots); stats_free(pref_of); stats_free(first_arc); stats_free(hub_arc); stats_free(part); stats_free(bpart);
+    stats_free(hub_batch_arc); stats_free(tagged); stats_free(names);
+    return rc;
+}
+
+/* ---------------- Strategy Comparison ---------------- */
+
+/* Compare works out how every strategy but prefs would fill the batches
+ * as things stand (placement mode, per-course setting, the next random
+ * seed) without seating anyone: each strategy seats into its own scratch
+ * array. Sorts are shared. marks and balanced use one marks order, and za
+ * is the az order reversed with tied names put back in slot order.
+ * Per-course runs split each whole-roster order by partition; a stable
+ * split of a sorted order is every partition sorted. The sorts run in
+ * parallel, then the strategies do. prefs is left out because it solves
+ * a flow over preference files rather than seating an order. */
+typedef struct {
+    const char *name;    /* as in strategies[] */
+    OrderKind kind;
+    int balanced;
+} CompareEntry;
+
+static const CompareEntry compare_entries[] = {
+    { "marks",    ORDER_MARKS_DESC, 0 },
+    { "az",       ORDER_NAME_ASC,   0 },
+    { "za",       ORDER_NAME_DESC,  0 },
+    { "sap",      ORDER_SAP_ASC,    0 },
+    { "random",   ORDER_RANDOM,     0 },
+    { "balanced", ORDER_MARKS_DESC, 1 },
+};
+
+#define COMPARE_COUNT ((int)(sizeof compare_entries / sizeof compare_entries[0]))
+
+/* The orders sorted (or shuffled) from scratch; za is derived */
+static const OrderKind compare_sorts[] = { ORDER_MARKS_DESC, ORDER_NAME_ASC, ORDER_SAP_ASC, ORDER_RANDOM };
+
+/* How one strategy fills each batch */
+typedef struct {
+    int *count, *lo, *hi;   /* per batch; marks in hundredths */
+    int64_t *sum;
+    double *sq;
+    int *mix;               /* per batch, per course (the last: no course) */
+    uint64_t cmps;
+    int failed;
+} CompareResult;
+
+typedef struct {
+    int *orders[ORDER_RANDOM + 1];   /* per kind: the n live students */
+    int n;
+    const CourseSplit *cs;           /* per-course runs, or NULL */
+    uint64_t seed;
+    int trials;
+    RandomRun run;                   /* the best-of-trials shuffle */
+    uint64_t sort_cmps[ORDER_RANDOM + 1];
+    CompareResult res[COMPARE_COUNT];
+} ComparePlan;
+
+static void compare_sort_task(int t, void *ctx) {
+    ComparePlan *plan = ctx;
+    OrderKind kind = compare_sorts[t];
+    if (kind == ORDER_RANDOM && plan->trials > 1) {
+        plan->orders[kind] = best_random_order(plan->seed, plan->trials, &plan->run);
+        return;
+    }
+    int *o = stats_malloc(sizeof(int) * (size_t)(plan->n ? plan->n : 1));
+    if (!o) return;
+    if (kind == ORDER_RANDOM && plan->cs) {
+        memcpy(o, plan->cs->slots, sizeof(int) * (size_t)plan->n);
+        course_split_shuffle(plan->cs, o, plan->seed);
+    } else {
+        int n = 0;
+        for (int i = 0; i < student_slots; ++i) if (student_alive(i)) o[n++] = i;
+        if (kind == ORDER_RANDOM) {
+            Rng r;
+            rng_seed(&r, plan->seed, 0);
+            shuffle_slots(&r, o, n);
+        } else if (sort_slots(kind, o, n, o, &plan->sort_cmps[kind]) != 0) {
+            stats_free(o);
+            return;
+        }
+    }
+    plan->orders[kind] = o;
+}
+
+/* za from az: names descending, equal names still by ascending slot */
+static void reverse_name_order(const int *az, int n, int *za, uint64_t *comparisons) {
+    for (int i = 0; i < n; ++i) za[i] = az[n - 1 - i];
+    for (int i = 0; i < n;) {
+        int j = i + 1;
+        for (; j < n; ++j) {
+            ++*comparisons;
+            if (order_fold_cmp(student_name(za[j - 1]), student_name(za[j])) != 0) break;
+        }
+        for (int a = i, b = j - 1; a < b; ++a, --b) { int t = za[a]; za[a] = za[b]; za[b] = t; }
+        i = j;
+    }
+}
+
+/* Seat one strategy into scratch and tally each batch */
+static void compare_task(int e, void *ctx) {
+    ComparePlan *plan = ctx;
+    const CompareEntry *ce = &compare_entries[e];
+    CompareResult *r = &plan->res[e];
+    const CourseSplit *cs = plan->cs;
+    const int *order = plan->orders[ce->kind];
+    int n = plan->n, nb = batch_count, nc = course_count + 1;
+    int *seats = stats_malloc(sizeof(int) * (size_t)(student_slots ? student_slots : 1));
+    int *split = cs ? stats_malloc(sizeof(int) * (size_t)(n ? n : 1)) : NULL;
+    int *cursor = cs ? stats_malloc(sizeof(int) * (size_t)cs->np) : NULL;
+    r->count = stats_calloc((size_t)nb * 3, sizeof(int));
+    r->sum = stats_calloc((size_t)nb, sizeof(int64_t));
+    r->sq = stats_calloc((size_t)nb, sizeof(double));
+    r->mix = stats_calloc((size_t)nb * nc, sizeof(int));
+    r->failed = !seats || (cs && (!split || !cursor)) || !r->count || !r->sum || !r->sq || !r->mix;
+    if (r->failed) goto done;
+    r->lo = r->count + nb;
+    r->hi = r->lo + nb;
+
+    for (int i = 0; i < student_slots; ++i) seats[i] = -1;
+    if (!cs) {
+        r->failed = (ce->balanced ? seat_balanced(order, n, NULL, nb, &r->cmps, seats)
+                                  : seat_in_order(order, n, NULL, nb, seats)) != 0;
+    } else {
+        for (int p = 0; p < cs->np; ++p) cursor[p] = cs->sstart[p];
+        for (int k = 0; k < n; ++k) split[cursor[course_partition_of(cs, order[k])]++] = order[k];
+        for (int p = 0; p < cs->np && !r->failed; ++p) {
+            const int *seg = split + cs->sstart[p], *bids = cs->bids + cs->bstart[p];
+            int len = cs->sstart[p + 1] - cs->sstart[p], pb = cs->bstart[p + 1] - cs->bstart[p];
+            if (len == 0 || pb == 0) continue;
+            r->failed = (ce->balanced ? seat_balanced(seg, len, bids, pb, &r->cmps, seats)
+                                      : seat_in_order(seg, len, bids, pb, seats)) != 0;
+        }
+    }
+    for (int i = 0; i < student_slots && !r->failed; ++i) {
+        int b = seats[i], m = st_marks[i];
+        if (b < 0) continue;
+        if (r->count[b] == 0 || m < r->lo[b]) r->lo[b] = m;
+        if (r->count[b] == 0 || m > r->hi[b]) r->hi[b] = m;
+        r->count[b]++;
+        r->sum[b] += m;
+        r->sq[b] += (double)m * m;
+        r->mix[b * nc + (st_course[i] >= 0 ? st_course[i] : course_count)]++;
+    }
+done:
+    stats_free(seats); stats_free(split); stats_free(cursor);
+}
+
+/* "CSE 12, EE 8", courses in id order, truncated to size */
+static void format_mix(const int *mix, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int c = 0; c <= course_count && len < size; ++c) {
+        if (mix[c] == 0) continue;
+        int w = snprintf(buf + len, size - len, "%s%s %d", len ? ", " : "", c < course_count ? course_name(c) : "(none)",
+                         mix[c]);
+        if (w < 0) break;
+        len += (size_t)w;
+    }
+}
+
+/* Seated students, the range and sd of the batch means, and the course
+ * mix's chi-square statistic over its degrees of freedom (0 when every
+ * batch has the course make-up of the whole; about 1 for random seating) */
+static void compare_summary(const CompareResult *r, int *seated, double *range, double *sd, double *chi) {
+    int nb = batch_count, nc = course_count + 1, used = 0, courses = 0;
+    double lo = 0, hi = 0, msum = 0, msq = 0;
+    int *total = stats_calloc((size_t)nc, sizeof(int));
+    *seated = 0;
+    for (int b = 0; b < nb; ++b) {
+        if (r->count[b] == 0) continue;
+        double mean = (double)r->sum[b] / r->count[b] / MARKS_SCALE;
+        if (used == 0 || mean < lo) lo = mean;
+        if (used == 0 || mean > hi) hi = mean;
+        msum += mean; msq += mean * mean;
+        used++;
+        *seated += r->count[b];
+        for (int c = 0; total && c < nc; ++c) total[c] += r->mix[b * nc + c];
+    }
+    double mm = used ? msum / used : 0, var = used ? msq / used - mm * mm : 0;
+    *range = hi - lo;
+    *sd = sqrt(var > 0 ? var : 0);
+    *chi = 0;
+    for (int c = 0; total && c < nc; ++c) courses += total[c] > 0;
+    if (courses < 2 || used < 2) { stats_free(total); return; }
+    for (int b = 0; b < nb; ++b) {
+        for (int c = 0; c < nc; ++c) {
+            if (total[c] == 0 || r->count[b] == 0) continue;
+            double e = (double)r->count[b] * total[c] / *seated, o = r->mix[b * nc + c];
+            *chi += (o - e) * (o - e) / e;
+        }
+    }
+    *chi /= (double)(courses - 1) * (used - 1);
+    stats_free(total);
+}
+
+static void write_compare_report(FILE *f, const ComparePlan *plan) {
+    int nb = batch_count, nc = course_count + 1;
+    char mix[160];
+    fprintf(f, "Strategy comparison: %d students, %d batches, %s placement%s. Nothing was changed.\n", plan->n, nb,
+            proportional_placement ? "proportional" : "round-robin", plan->cs ? ", per course" : "");
+    for (int e = 0; e < COMPARE_COUNT; ++e) {
+        const CompareResult *r = &plan->res[e];
+        fprintf(f, "\n%s", compare_entries[e].name);
+        if (compare_entries[e].kind == ORDER_RANDOM) {
+            fprintf(f, " (seed %llu", (unsigned long long)plan->seed);
+            if (plan->trials > 1) fprintf(f, ", best of %d shuffles", plan->trials);
+            fprintf(f, ")");
+        }
+        fprintf(f, "\n  %-20s %11s %7s %7s %7s %7s  %s\n", "batch", "seated", "mean", "sd", "min", "max", "course mix");
+        for (int b = 0; b < nb; ++b) {
+            int k = r->count[b];
+            if (k == 0) {
+                fprintf(f, "  %-20s %5d/%-5d %7s %7s %7s %7s\n", batches[b].name, 0, batches[b].capacity, "-", "-", "-", "-");
+                continue;
+            }
+            double mean = (double)r->sum[b] / k, var = r->sq[b] / k - mean * mean;
+            format_mix(r->mix + (size_t)b * nc, mix, sizeof mix);
+            fprintf(f, "  %-20s %5d/%-5d %7.2f %7.2f %7.2f %7.2f  %s\n", batches[b].name, k, batches[b].capacity,
+                    mean / MARKS_SCALE, sqrt(var > 0 ? var : 0) / MARKS_SCALE, (double)r->lo[b] / MARKS_SCALE,
+                    (double)r->hi[b] / MARKS_SCALE, mix);
+        }
+    }
+    fprintf(f, "\nSummary (smaller mean range, mean sd and mix score mean more even batches):\n");
+    fprintf(f, "  %-10s %8s %9s %11s %8s %10s\n", "strategy", "seated", "unseated", "mean range", "mean sd", "mix score");
+    for (int e = 0; e < COMPARE_COUNT; ++e) {
+        int seated;
+        double range, sd, chi;
+        compare_summary(&plan->res[e], &seated, &range, &sd, &chi);
+        fprintf(f, "  %-10s %8d %9d %11.2f %8.2f %10.3f\n", compare_entries[e].name, seated, plan->n - seated, range, sd, chi);
+    }
+    fprintf(f, "The next random allocation uses seed %llu, so it seats as shown.\n", (unsigned long long)plan->seed);
+}
+
+/* Run every strategy in compare_entries into scratch and write the
+ * comparison to f. Students, batches and seats are untouched; the next
+ * random seed is drawn if none was set. Returns 0, or -1 on memory error. */
+static int compare_strategies(FILE *f) {
+    if (student_count == 0 || batch_count == 0) { report_error("Need students and batches to compare.\n"); return -1; }
+    ComparePlan *plan = stats_calloc(1, sizeof *plan);
+    CourseSplit cs = { 0 };
+    int rc = -1, split = 0;
+    if (!plan || (course_partitioned && !(split = course_split(&cs) == 0))) { stats_free(plan); report_error("Memory error.\n"); return -1; }
+    plan->n = student_count;
+    plan->cs = split ? &cs : NULL;
+    plan->seed = peek_random_seed();
+    plan->trials = course_partitioned ? 1 : random_trials;
+    int threads = pool_default_threads();
+
+    PhaseMark m;
+    phase_begin(&m);
+    int nsorts = (int)(sizeof compare_sorts / sizeof compare_sorts[0]);
+    pool_run(nsorts, threads, compare_sort_task, plan);
+    int *az = plan->orders[ORDER_NAME_ASC];
+    uint64_t cmps = 0;
+    if (az && (plan->orders[ORDER_NAME_DESC] = stats_malloc(sizeof(int) * (size_t)plan->n)) != NULL) {
+        reverse_name_order(az, plan->n, plan->orders[ORDER_NAME_DESC], &cmps);
+        rc = 0;
+    }
+    for (int k = 0; k < nsorts; ++k) {
+        if (!plan->orders[compare_sorts[k]]) rc = -1;
+        cmps += plan->sort_cmps[compare_sorts[k]];
+    }
+    phase_end(PHASE_SORT, &m, rc, "sort", "compare (marks, names, sap, random)", (uint64_t)plan->n, cmps);
+
+    if (rc == 0) {
+        phase_begin(&m);
+        pool_run(COMPARE_COUNT, threads, compare_task, plan);
+        cmps = 0;
+        for (int e = 0; e < COMPARE_COUNT; ++e) {
+            if (plan->res[e].failed) rc = -1;
+            cmps += plan->res[e].cmps;
+        }
+        char what[64];
+        snprintf(what, sizeof what, "%d strategies%s%s", COMPARE_COUNT, course_partitioned ? " (by course)" : "",
+                 proportional_placement ? " (proportional)" : "");
+        phase_end(PHASE_ALLOCATE, &m, rc, "compare", what, (uint64_t)plan->n, cmps);
+    }
+    if (rc == 0) write_compare_report(f, plan);
+    else report_error("Memory error.\n");
+
+    for (int k = 0; k <= ORDER_RANDOM; ++k) stats_free(plan->orders[k]);
+    for (int e = 0; e < COMPARE_COUNT; ++e) {
+        stats_free(plan->res[e].count); stats_free(plan->res[e].sum); stats_free(plan->res[e].sq); stats_free(plan->res[e].mix);
+    }
+    if (split) course_split_free(&cs);
+    stats_free(plan);
+    return rc;
+}
+
+/* ---------------- Incremental Maintenance ---------------- */
+
+/* Take ownership of the order a strategy just allocated from */
+static void remember_order(OrderKind kind, int *order) {
+    stats_free(alloc_order);
+    alloc_kind = kind;
+    alloc_order = order;
+    alloc_order_len = student_count;
+    alloc_order_cap = student_count;
+    alloc_order_dead = 0;
+    alloc_wait_hint = 0;
+}
+
+static void forget_allocation_order(void) {
+    stats_free(alloc_order);
+    alloc_order = NULL;
+    alloc_kind = ORDER_NONE;
+    alloc_order_len = alloc_order_cap = alloc_order_dead = alloc_wait_hint = 0;
+}
+
+/* Deleted students stay in the order as dead entries (their slot data is
+ * left untouched, so they still compare correctly) until compaction. Their
+ * slots must not be recycled meanwhile. */
+static int order_blocks_reuse(void) {
+    return alloc_kind != ORDER_NONE && alloc_order_dead > 0;
+}
+
+static void compact_order(void) {
+    int o = 0;
+    for (int i = 0; i < alloc_order_len; ++i) {
+        if (student_alive(alloc_order[i])) alloc_order[o++] = alloc_order[i];
+    }
+    alloc_order_len = o;
+    alloc_order_dead = 0;
+    alloc_wait_hint = 0;
+}
+
+/* Whether student a sorts before student b under the remembered strategy;
+ * mirrors build_order, including the slot tiebreak. */
+static int order_precedes(int a, int b) {
+    int c = 0;
+    if (alloc_kind == ORDER_MARKS_DESC) c = st_marks[b] - st_marks[a];
+    else if (alloc_kind == ORDER_NAME_ASC) c = order_fold_cmp(student_name(a), student_name(b));
+    else if (alloc_kind == ORDER_NAME_DESC) c = order_fold_cmp(student_name(b), student_name(a));
+    else if (alloc_kind == ORDER_SAP_ASC) c = order_fold_cmp(student_sap(a), student_sap(b));
+    return c != 0 ? c < 0 : a < b;
+}
+
+/* Position idx belongs at: binary search for sorted strategies, a uniform
+ * random slot for the random one. */
+static int order_position(int idx) {
+    if (alloc_kind == ORDER_RANDOM) return (int)rng_below(&order_rng, (uint32_t)alloc_order_len + 1);
+    int lo = 0, hi = alloc_order_len;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (order_precedes(alloc_order[mid], idx)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void order_insert_at(int pos, int idx) {
+    void *buf = alloc_order;
+    if (grow_array(&buf, &alloc_order_cap, alloc_order_len + 1, sizeof(int)) != 0) {
+        forget_allocation_order();
+        return;
+    }
+    alloc_order = buf;
+    memmove(alloc_order + pos + 1, alloc_order + pos, sizeof(int) * (size_t)(alloc_order_len - pos));
+    alloc_order[pos] = idx;
+    alloc_order_len++;
+    if (pos < alloc_wait_hint) alloc_wait_hint = pos;
+}
+
+/* Seat idx in the first batch with room, starting at start and probing
+ * round-robin; with proportional placement, in the batch with room whose
+ * fill ratio stays lowest (ties go to the first from start) */
+static int seat_from(int idx, int start) {
+    int best = -1;
+    for (int d = 0; d < batch_count; ++d) {
+        int bi = (start + d) % batch_count;
+        if (batches[bi].filled >= batches[bi].capacity) continue;
+        if (!proportional_placement) { best = bi; break; }
+        if (best < 0 || (int64_t)(batches[bi].filled + 1) * batches[best].capacity <
+                        (int64_t)(batches[best].filled + 1) * batches[bi].capacity) best = bi;
+    }
+    if (best >= 0) {
+        seat_in(idx, best);
+        wal_log_seat(idx);
+    }
+    return best;
+}
+
+/* A new student takes their place in the order and, in incremental mode,
+ * the seat the round-robin would give them there: the batch after their
+ * predecessor's (with proportional placement, the batch furthest behind
+ * its share). O(log n) search plus an O(B) probe. */
+static void incremental_add(int idx) {
+    if (alloc_kind == ORDER_NONE || batch_count == 0) return;
+    int pos = order_position(idx);
+    order_insert_at(pos, idx);
+    if (!incremental_alloc || alloc_kind == ORDER_NONE) return;
+    int start = 0;
+    for (int p = pos - 1; p >= 0; --p) {
+        int b = st_batch[alloc_order[p]];
+        if (b >= 0) { start = (b + 1) % batch_count; break; }
+        if (pos - p > batch_count) break; /* predecessors unseated: capacity is exhausted */
+    }
+    seat_from(idx, start);
+}
+
+/* idx's sort key is about to change to (new_marks, new_name): move it
+ * within the order, keeping its seat. Called while the old key is still
+ * in place so the entry can be found by binary search. */
+static void incremental_reorder(int idx, int new_marks, uint32_t new_name) {
+    int at = -1;
+    if (alloc_kind != ORDER_NONE && alloc_kind != ORDER_RANDOM) {
+        int pos = order_position(idx);
+        if (pos < alloc_order_len && alloc_order[pos] == idx) at = pos;
+    }
+    st_marks[idx] = new_marks;
+    st_name[idx] = new_name;
+    if (at < 0) return;
+    memmove(alloc_order + at, alloc_order + at + 1, sizeof(int) * (size_t)(alloc_order_len - at - 1));
+    alloc_order_len--;
+    if (at < alloc_wait_hint) alloc_wait_hint = at;
+    order_insert_at(order_position(idx), idx);
+}
+
+/* Student idx was deleted. Its order entry goes dead (compacted once dead
+ * entries are half the order, so amortised O(1)); in incremental mode its
+ * seat goes to the first unseated student in order, as a full re-run
+ * would. */
+static void incremental_remove(int idx, int freed_batch) {
+    (void)idx;
+    if (alloc_kind == ORDER_NONE) return;
+    alloc_order_dead++;
+    if (alloc_order_dead * 2 > alloc_order_len) compact_order();
+    if (!incremental_alloc || freed_batch < 0) return;
+    int seated = 0;
+    for (int b = 0; b < batch_count; ++b) seated += batches[b].filled;
+    if (seated >= student_count) return; /* nobody is waiting */
+    for (; alloc_wait_hint < alloc_order_len; ++alloc_wait_hint) {
+        int v = alloc_order[alloc_wait_hint];
+        if (student_alive(v) && st_batch[v] < 0) { seat_from(v, freed_batch); break; }
+    }
+}
+
+/* ---------------- CSV Save/Load ---------------- */
+
+/* The batch definitions behind a student CSV's allocated_batch column are
+ * kept next to it in FILE.batches, in batch spec format, so loading the
+ * CSV restores the allocation. */
+static void batch_sidecar_name(char *dst, size_t n, const char *csv) {
+    snprintf(dst, n, "%s.batches", csv);
+}
+
+/* Writes the sidecar for a CSV just saved to filename, or removes a stale
+ * one when there are no batches. Skipped for pipes and devices. */
+static int write_batch_sidecar(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    char side[1024];
+    batch_sidecar_name(side, sizeof side, filename);
+    if (batch_count == 0) {
+        if (file_exists(side)) remove(side);
+        return 0;
+    }
+    CsvWriter w;
+    if (csvw_open(&w, side) != 0) { report_error("Could not open %s for writing.\n", side); return -1; }
+    csvw_raw(&w, "name,capacity,course");
+    csvw_end_row(&w);
+    for (int b = 0; b < batch_count; ++b) {
+        csvw_str(&w, 0, batches[b].name);
+        csvw_int(&w, ',', batches[b].capacity);
+        if (batches[b].course >= 0) csvw_str(&w, ',', course_name(batches[b].course));
+        csvw_end_row(&w);
+    }
+    if (csvw_close(&w) != 0) { report_error("Error while writing %s.\n", side); return -1; }
+    report("Saved %d batch definitions to %s\n", batch_count, side);
+    return 0;
+}
+
+static int write_csv_file(const char *filename) {
+    if (!filename) return -1;
+    CsvWriter w;
+    if (csvw_open(&w, filename) != 0) { report_error("Could not open %s for writing.\n", filename); return -1; }
+    csvw_raw(&w, "sap,name,marks,course,allocated_batch");
+    csvw_end_row(&w);
+    for (int i = 0; i < student_slots; ++i) {
+        if (!student_alive(i)) continue;
+        csvw_str(&w, 0, student_sap(i));
+        csvw_str(&w, ',', student_name(i));
+        csvw_fixed(&w, ',', st_marks[i], 2);
+        csvw_str(&w, ',', student_course(i));
+        csvw_int(&w, ',', st_batch[i]);
+        csvw_end_row(&w);
+    }
+    if (csvw_close(&w) != 0) { report_error("Error while writing %s.\n", filename); return -1; }
+    report("Saved %d students to %s\n", student_count, filename);
+    return write_batch_sidecar(filename);
+}
+
+/* Every batch's members in seating order, batch by batch; unallocated
+ * students are not listed */
+static int write_rosters_file(const char *filename) {
+    if (!filename) return -1;
+    CsvWriter w;
+    if (csvw_open(&w, filename) != 0) { report_error("Could not open %s for writing.\n", filename); return -1; }
+    csvw_raw(&w, "batch,seat,sap,name,marks,course");
+    csvw_end_row(&w);
+    int listed = 0;
+    for (int b = 0; b < batch_count; ++b) {
+        const Batch *bt = &batches[b];
+        size_t blen = strlen(bt->name);
+        for (int j = 0; j < bt->filled; ++j) {
+            int i = bt->members[j];
+#if defined(__GNUC__)
+            /* members sit in seating order, so their slots are scattered:
+             * fetch a few students ahead, columns first, then strings */
+            if (j + 16 < bt->filled) {
+                int f = bt->members[j + 16];
+                __builtin_prefetch(&st_sap[f]);
+                __builtin_prefetch(&st_name[f]);
+                __builtin_prefetch(&st_marks[f]);
+                __builtin_prefetch(&st_course[f]);
+            }
+            if (j + 8 < bt->filled) {
+                int f = bt->members[j + 8];
+                __builtin_prefetch(student_sap(f));
+                __builtin_prefetch(student_name(f));
+            }
+#endif
+            csvw_field(&w, 0, bt->name, blen);
+            csvw_int(&w, ',', j + 1);
+            csvw_str(&w, ',', student_sap(i));
+            csvw_str(&w, ',', student_name(i));
+            csvw_fixed(&w, ',', st_marks[i], 2);
+            csvw_str(&w, ',', student_course(i));
+            csvw_end_row(&w);
+        }
+        listed += bt->filled;
+    }
+    if (csvw_close(&w) != 0) { report_error("Error while writing %s.\n", filename); return -1; }
+    report("Saved rosters of %d batches (%d students) to %s\n", batch_count, listed, filename);
+    return 0;
+}
+
+/* Columns load_csv understands, matched by header name */
+enum { COL_SAP, COL_NAME, COL_MARKS, COL_COURSE, COL_BATCH, COL_COUNT };
+
+#define CSV_MAX_FIELDS 16
+
+static int csv_field_int(const CsvField *f, int fallback) {
+    char buf[32];
+    csv_field_copy(f, buf, sizeof buf);
+    char *end;
+    long v = strtol(buf, &end, 10);
+    return end == buf ? fallback : (int)v;
+}
+
+/* A marks column in hundredths */
+static int csv_field_marks(const CsvField *f, int fallback) {
+    char buf[32];
+    csv_field_copy(f, buf, sizeof buf);
+    int v;
+    return parse_marks(buf, strlen(buf), &v) == 0 ? v : fallback;
+}
+
+/* Map header names to columns. Falls back to the sap,name,marks,allocated_batch
+ * layout written by save_csv when the header names nothing we know. */
+static void map_csv_columns(const CsvField *hdr, int nf, int col[COL_COUNT]) {
+    int found = 0;
+    for (int c = 0; c < COL_COUNT; ++c) col[c] = -1;
+    for (int i = 0; i < nf && i < CSV_MAX_FIELDS; ++i) {
+        int c = -1;
+        if (csv_field_is(&hdr[i], "sap") || csv_field_is(&hdr[i], "roll")) c = COL_SAP;
+        else if (csv_field_is(&hdr[i], "name")) c = COL_NAME;
+        else if (csv_field_is(&hdr[i], "marks")) c = COL_MARKS;
+        else if (csv_field_is(&hdr[i], "course")) c = COL_COURSE;
+        else if (csv_field_is(&hdr[i], "allocated_batch") || csv_field_is(&hdr[i], "batch")) c = COL_BATCH;
+        if (c >= 0 && col[c] < 0) { col[c] = i; found++; }
+    }
+    if (found == 0) {
+        col[COL_SAP] = 0; col[COL_NAME] = 1; col[COL_MARKS] = 2; col[COL_BATCH] = 3;
+    }
+}
+
+/* Parallel loading: the records after the header are cut into chunks at
+ * line starts and each chunk is parsed on a pool thread into its own rows
+ * and string pool. The chunks are then merged in file order, so slots,
+ * interning and duplicate detection (first row wins) match a serial load. */
+#define LOAD_CHUNK_BYTES (1 << 20)
+#define LOAD_MAX_CHUNKS 256
+/* The SAP index is cut into up to this many slot ranges, each filled by one
+ * task, and no range is made smaller than LOAD_PART_MIN slots */
+#define LOAD_SAP_PARTS 64
+#define LOAD_PART_MIN 4096
+
+/* One data row with its text fields copied out (and unescaped) */
+typedef struct {
+    char sap[SAP_LEN], name[NAME_LEN], course[32];
+    size_t sap_len, name_len, course_len;
+    int marks, batch;
+} CsvRow;
+
+/* LoadRow.slot while the rows are entered into the SAP index */
+#define LOAD_DUPLICATE (-1)       /* an earlier row has the same SAP */
+#define LOAD_DEFERRED (-2)        /* the probe left its partition; entered serially */
+
+typedef struct {
+    uint32_t sap, name;           /* offsets into the chunk's pool */
+    uint32_t hash;                /* sap_hash of the SAP */
+    uint16_t sap_len, name_len;
+    int course;                   /* index into the chunk's courses, or -1 */
+    int marks, batch;
+    int slot;                     /* student slot once added, or LOAD_* */
+} LoadRow;
+
+typedef struct {
+    uint32_t off;                 /* name in the chunk's pool */
+    int id;                       /* global course id, set by the merge */
+} LoadCourse;
+
+typedef struct {
+    const char *begin, *end;      /* records starting in [begin, end) */
+    const char *stop;             /* where the last record actually ended */
+    LoadRow *rows;
+    int nrows, cap;
+    StrPool strs;                 /* names and courses interned per chunk */
+    LoadCourse *courses;          /* in order of first use */
+    int ncourses, course_cap;
+    int *by_part;                 /* row numbers grouped by SAP index partition */
+    int part_start[LOAD_SAP_PARTS + 1];
+    int base;                     /* rows in the chunks before this one */
+    int kept;                     /* rows that are not duplicates */
+    int slot_base;                /* slot of the first kept row */
+    uint32_t str_base;            /* where strs lands in student_strs */
+    int failed;
+} LoadChunk;
+
+typedef struct {
+    LoadChunk *chunks;
+    const char *data_end;
+    const int *col;
+} LoadPlan;
+
+typedef struct {
+    LoadChunk *chunks;
+    int nchunks;
+    int nparts, shift;            /* SAP index slot >> shift = partition */
+    int placed[LOAD_SAP_PARTS], deferred[LOAD_SAP_PARTS];
+} LoadMerge;
+
+/* Returns 0 for a blank line (no SAP), 1 otherwise */
+static int csv_row_parse(const CsvField *fields, int nf, const int *col, CsvRow *r) {
+    if (nf > CSV_MAX_FIELDS) nf = CSV_MAX_FIELDS;
+    if (col[COL_SAP] >= nf || fields[col[COL_SAP]].len == 0) return 0;
+    r->sap_len = csv_field_copy(&fields[col[COL_SAP]], r->sap, sizeof r->sap);
+    r->name_len = r->course_len = 0;
+    r->name[0] = r->course[0] = '\0';
+    if (col[COL_NAME] >= 0 && col[COL_NAME] < nf) r->name_len = csv_field_copy(&fields[col[COL_NAME]], r->name, sizeof r->name);
+    if (col[COL_COURSE] >= 0 && col[COL_COURSE] < nf) r->course_len = csv_field_copy(&fields[col[COL_COURSE]], r->course, sizeof r->course);
+    r->marks = (col[COL_MARKS] >= 0 && col[COL_MARKS] < nf) ? csv_field_marks(&fields[col[COL_MARKS]], 0) : 0;
+    r->batch = (col[COL_BATCH] >= 0 && col[COL_BATCH] < nf) ? csv_field_int(&fields[col[COL_BATCH]], -1) : -1;
+    return 1;
+}
+
+/* Add a loaded row. Returns the slot, -2 for a duplicate SAP, -1 on memory error. */
+static int csv_row_add(const char *sap, size_t sap_len, const char *name, size_t name_len,
+                       const char *course, size_t course_len, int marks, int batch) {
+    if (batch >= batch_count) batch = -1; /* batch definitions are not part of the CSV */
+    int cid = course_id(course, course_len);
+    return cid < -1 ? -1 : append_student(sap, sap_len, name, name_len, marks, cid, batch);
+}
+
+/* The chunk's index for a course name, like course_id: -1 for an empty
+ * name, -2 on memory error */
+static int load_chunk_course(LoadChunk *c, const char *s, size_t n) {
+    if (n == 0) return -1;
+    uint32_t off = strpool_intern(&c->strs, s, n);
+    if (off == STRPOOL_NONE) return -2;
+    for (int k = 0; k < c->ncourses; ++k) if (c->courses[k].off == off) return k;
+    void *buf = c->courses;
+    if (grow_array(&buf, &c->course_cap, c->ncourses + 1, sizeof(LoadCourse)) != 0) return -2;
+    c->courses = buf;
+    c->courses[c->ncourses].off = off;
+    return c->ncourses++;
+}
+
+static const char *load_row_course(const LoadChunk *c, const LoadRow *r) {
+    return r->course >= 0 ? strpool_get(&c->strs, c->courses[r->course].off) : "";
+}
+
+static void load_chunk_free(LoadChunk *c) {
+    stats_free(c->rows); c->rows = NULL;
+    stats_free(c->courses); c->courses = NULL;
+    stats_free(c->by_part); c->by_part = NULL;
+    strpool_free(&c->strs);
+}
+
+static void load_chunk_task(int k, void *ctx) {
+    LoadPlan *plan = ctx;
+    LoadChunk *c = &plan->chunks[k];
+    const int *col = plan->col;
+    const char *pos = c->begin;
+    CsvField fields[CSV_MAX_FIELDS];
+    /* a quoted field may run past c->end; the merge checks for that */
+    while (pos < c->end) {
+        int nf = csv_next_record(&pos, plan->data_end, fields, CSV_MAX_FIELDS);
+        CsvRow row;
+        if (!csv_row_parse(fields, nf, col, &row)) continue;
+        void *buf = c->rows;
+        if (grow_array(&buf, &c->cap, c->nrows + 1, sizeof(LoadRow)) != 0) { c->failed = 1; break; }
+        c->rows = buf;
+        LoadRow *r = &c->rows[c->nrows++];
+        r->sap_len = (uint16_t)row.sap_len;
+        r->name_len = (uint16_t)row.name_len;
+        r->marks = row.marks;
+        r->batch = row.batch;
+        r->hash = sap_hash(row.sap);
+        r->sap = strpool_add(&c->strs, row.sap, row.sap_len);
+        r->name = strpool_intern(&c->strs, row.name, row.name_len);
+        r->course = load_chunk_course(c, row.course, row.course_len);
+        if (r->sap == STRPOOL_NONE || r->name == STRPOOL_NONE || r->course < -1) { c->failed = 1; break; }
+    }
+    c->stop = pos;
+}
+
+/* Cut [p, end) into n chunks at line starts and parse them in parallel. If
+ * a quoted field spans a cut, the chunks after it started mid-record, so
+ * everything is parsed again as one chunk. Returns the number of chunks, or
+ * -1 on memory error (the chunks are freed). */
+static int load_chunks_parse(LoadChunk *chunks, int n, const char *p, const char *end, const int *col) {
+    LoadPlan plan = { chunks, end, col };
+    size_t size = (size_t)(end - p);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        const char *at = p;
+        for (int k = 0; k < n; ++k) {
+            memset(&chunks[k], 0, sizeof chunks[k]);
+            chunks[k].begin = at;
+            at = k + 1 < n ? csv_next_line(p + size / (size_t)n * (size_t)(k + 1) - 1, end) : end;
+            if (at < chunks[k].begin) at = chunks[k].begin;
+            chunks[k].end = at;
+        }
+        pool_run(n, pool_default_threads(), load_chunk_task, &plan);
+        int failed = 0, misaligned = 0;
+        for (int k = 0; k < n; ++k) {
+            failed |= chunks[k].failed;
+            if (k + 1 < n && chunks[k].stop != chunks[k + 1].begin) misaligned = 1;
+        }
+        if (!failed && !misaligned) return n;
+        for (int k = 0; k < n; ++k) load_chunk_free(&chunks[k]);
+        if (failed) return -1;
+        n = 1;
+    }
+    return -1; /* unreachable: a single chunk is always aligned */
+}
+
+/* The row with global number id (chunk base + index) */
+static const LoadRow *load_row_at(const LoadMerge *lm, int id, const LoadChunk **owner) {
+    int lo = 0, hi = lm->nchunks - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (lm->chunks[mid].base <= id) lo = mid;
+        else hi = mid - 1;
+    }
+    if (owner) *owner = &lm->chunks[lo];
+    return &lm->chunks[lo].rows[id - lm->chunks[lo].base];
+}
+
+/* Enter row j of c into the SAP index under its global row number,
+ * probing from its home slot. Returns 0 once entered, LOAD_DUPLICATE if
+ * an entered row has the same SAP, or LOAD_DEFERRED if the probe reaches
+ * slot limit (-1 for none). */
+static int load_sap_place(const LoadMerge *lm, const LoadChunk *c, int j, int limit) {
+    const LoadRow *r = &c->rows[j];
+    const char *sap = strpool_get(&c->strs, r->sap);
+    int mask = sap_cap - 1;
+    int pos = (int)(r->hash & (uint32_t)mask);
+    for (;;) {
+        if (sap_slots[pos].idx < 0) {
+            sap_slots[pos].hash = r->hash;
+            sap_slots[pos].idx = c->base + j;
+            return 0;
+        }
+        if (sap_slots[pos].hash == r->hash) {
+            const LoadChunk *o;
+            const LoadRow *e = load_row_at(lm, sap_slots[pos].idx, &o);
+            if (strcmp(strpool_get(&o->strs, e->sap), sap) == 0) return LOAD_DUPLICATE;
+        }
+        pos = (pos + 1) & mask;
+        if (pos == limit) return LOAD_DEFERRED;
+    }
+}
+
+/* Group the chunk's rows by the partition of their home slot, keeping
+ * file order within each group */
+static void load_bucket_task(int k, void *ctx) {
+    LoadMerge *lm = ctx;
+    LoadChunk *c = &lm->chunks[k];
+    uint32_t mask = (uint32_t)sap_cap - 1;
+    int at[LOAD_SAP_PARTS] = { 0 };
+    c->by_part = stats_malloc(sizeof(int) * (size_t)(c->nrows > 0 ? c->nrows : 1));
+    if (!c->by_part) { c->failed = 1; return; }
+    for (int j = 0; j < c->nrows; ++j) at[(c->rows[j].hash & mask) >> lm->shift]++;
+    c->part_start[0] = 0;
+    for (int p = 0; p < lm->nparts; ++p) {
+        c->part_start[p + 1] = c->part_start[p] + at[p];
+        at[p] = c->part_start[p];
+    }
+    for (int j = 0; j < c->nrows; ++j) c->by_part[at[(c->rows[j].hash & mask) >> lm->shift]++] = j;
+}
+
+/* Enter every row homed in partition p, chunk by chunk so the first of
+ * two equal SAPs wins. Equal SAPs share a home slot, so they always meet
+ * in the same partition; probes never leave the partition's slots. */
+static void load_sap_task(int p, void *ctx) {
+    LoadMerge *lm = ctx;
+    int limit = ((p + 1) << lm->shift) & (sap_cap - 1);
+    for (int k = 0; k < lm->nchunks; ++k) {
+        LoadChunk *c = &lm->chunks[k];
+        for (int i = c->part_start[p]; i < c->part_start[p + 1]; ++i) {
+            int j = c->by_part[i];
+            int r = load_sap_place(lm, c, j, limit);
+            c->rows[j].slot = r;
+            if (r == 0) lm->placed[p]++;
+            else if (r == LOAD_DEFERRED) lm->deferred[p]++;
+        }
+    }
+}
+
+static void load_count_task(int k, void *ctx) {
+    LoadMerge *lm = ctx;
+    LoadChunk *c = &lm->chunks[k];
+    c->kept = 0;
+    for (int j = 0; j < c->nrows; ++j) c->kept += c->rows[j].slot != LOAD_DUPLICATE;
+}
+
+/* Copy the chunk's strings into student_strs and its kept rows into
+ * their slots */
+static void load_fill_task(int k, void *ctx) {
+    LoadMerge *lm = ctx;
+    LoadChunk *c = &lm->chunks[k];
+    memcpy(student_strs.buf + c->str_base, c->strs.buf, c->strs.len);
+    int i = c->slot_base;
+    for (int j = 0; j < c->nrows; ++j) {
+        LoadRow *r = &c->rows[j];
+        if (r->slot == LOAD_DUPLICATE) continue;
+        r->slot = i;
+        st_sap[i] = c->str_base + r->sap;
+        st_name[i] = c->str_base + r->name;
+        st_marks[i] = r->marks;
+        st_course[i] = r->course >= 0 ? c->courses[r->course].id : -1;
+        st_batch[i] = r->batch < batch_count ? r->batch : -1;
+        st_member_pos[i] = -1;
+        st_gen[i] = 1;
+        i++;
+    }
+    strpool_free(&c->strs);
+}
+
+/* Point the index entries of partition p at slots instead of rows */
+static void load_reslot_task(int p, void *ctx) {
+    LoadMerge *lm = ctx;
+    for (int pos = p << lm->shift; pos < (p + 1) << lm->shift; ++pos)
+        if (sap_slots[pos].idx >= 0) sap_slots[pos].idx = load_row_at(lm, sap_slots[pos].idx, NULL)->slot;
+}
+
+/* Add the rows of n parsed chunks to an empty student list with the
+ * result of csv_row_add on each row in file order. Course ids are
+ * assigned serially (there are few); the SAP index is filled one slot
+ * range per task, and the columns and strings one chunk per task. Names
+ * are interned per chunk only. The columns and the SAP index must be
+ * reserved for every row. Returns the number of duplicate rows skipped,
+ * or -1 on memory error. */
+static int load_chunks_add(LoadChunk *chunks, int n) {
+    LoadMerge lm = { chunks, n, LOAD_SAP_PARTS, 0, { 0 }, { 0 } };
+    int threads = pool_default_threads(), rows = 0;
+    for (int k = 0; k < n; ++k) {
+        LoadChunk *c = &chunks[k];
+        c->base = rows;
+        rows += c->nrows;
+        for (int i = 0; i < c->ncourses; ++i) {
+            const char *name = strpool_get(&c->strs, c->courses[i].off);
+            if ((c->courses[i].id = course_id(name, strlen(name))) < -1) return -1;
+        }
+    }
+    size_t strs = 0;
+    for (int k = 0; k < n; ++k) strs += chunks[k].strs.len;
+    if (strpool_reserve(&student_strs, strs) != 0) return -1;
+    strs = student_strs.len;
+    for (int k = 0; k < n; ++k) {
+        chunks[k].str_base = (uint32_t)strs;
+        strs += chunks[k].strs.len;
+    }
+
+    while (lm.nparts > 1 && sap_cap / lm.nparts < LOAD_PART_MIN) lm.nparts /= 2;
+    while ((1 << lm.shift) < sap_cap / lm.nparts) lm.shift++;
+    pool_run(n, threads, load_bucket_task, &lm);
+    for (int k = 0; k < n; ++k) if (chunks[k].failed) return -1;
+    pool_run(lm.nparts, threads, load_sap_task, &lm);
+    int deferred = 0;
+    for (int p = 0; p < lm.nparts; ++p) {
+        sap_used += lm.placed[p];
+        deferred += lm.deferred[p];
+    }
+    /* a deferred row's earlier duplicates were deferred too, so file order
+     * among these is all that decides which one is kept */
+    for (int k = 0; deferred > 0 && k < n; ++k) {
+        LoadChunk *c = &chunks[k];
+        for (int j = 0; j < c->nrows; ++j) {
+            if (c->rows[j].slot != LOAD_DEFERRED) continue;
+            c->rows[j].slot = load_sap_place(&lm, c, j, -1);
+            if (c->rows[j].slot == 0) sap_used++;
+        }
+    }
+
+    pool_run(n, threads, load_count_task, &lm);
+    int slots = 0;
+    for (int k = 0; k < n; ++k) {
+        chunks[k].slot_base = slots;
+        slots += chunks[k].kept;
+    }
+    pool_run(n, threads, load_fill_task, &lm);
+    pool_run(lm.nparts, threads, load_reslot_task, &lm);
+    student_strs.len = strs;
+    student_slots = student_count = slots;
+    return rows - slots;
+}
+
+/* Loads the whole file through one mapping. Small files are added as
+ * they are tokenised; larger ones are parsed in chunks on all cores (see
+ * load_chunk_task) and added by load_chunks_add. Either way the student
+ * columns and the SAP index are sized once up front. */
+static int read_csv_file(const char *filename) {
+    if (!filename) return -1;
+    CsvFile cf;
+    if (csv_open(filename, &cf) != 0) { report_error("Could not open %s for reading.\n", filename); return -1; }
+
+    const char *pos = cf.data, *end = cf.data + cf.size;
+    CsvField fields[CSV_MAX_FIELDS];
+    int nf = csv_next_record(&pos, end, fields, CSV_MAX_FIELDS);
+    if (nf == 0) { csv_close(&cf); return 0; }
+    int col[COL_COUNT];
+    map_csv_columns(fields, nf, col);
+
+    int threads = pool_default_threads();
+    size_t want = (size_t)(end - pos) / LOAD_CHUNK_BYTES;
+    if (want > (size_t)threads * 4) want = (size_t)threads * 4;
+    int nchunks = want < 2 ? 0 : want > LOAD_MAX_CHUNKS ? LOAD_MAX_CHUNKS : (int)want;
+    LoadChunk *chunks = NULL;
+    if (nchunks > 0) {
+        chunks = stats_malloc(sizeof(LoadChunk) * (size_t)nchunks);
+        if (!chunks || (nchunks = load_chunks_parse(chunks, nchunks, pos, end, col)) < 0) {
+            report_error("Memory error while loading.\n");
+            stats_free(chunks);
+            csv_close(&cf);
+            return -1;
+        }
+    }
+    size_t rows = 0;
+    if (chunks) for (int k = 0; k < nchunks; ++k) rows += (size_t)chunks[k].nrows;
+    else rows = csv_count_rows(pos, end);
+
+    int rc = 0, duplicates = 0;
+    if (rows > (size_t)(INT32_MAX / 2)) { report_error("%s has too many rows.\n", filename); rc = -1; goto done; }
+
+    free_batches();
+    clear_students();
+    sap_index_rebuild();
+
+    char side[1024];
+    batch_sidecar_name(side, sizeof side, filename);
+    if (file_exists(side) && load_batch_spec(side) != 0) {
+        report_error("Ignoring %s; students are loaded unallocated.\n", side);
+        free_batches();
+    }
+
+    /* the strings can never need more room than the file itself */
+    if (rows > 0 && (reserve_students((int)rows) != 0 || sap_index_reserve((int)rows) != 0 ||
+                     strpool_reserve(&student_strs, cf.size) != 0)) {
+        report_error("Memory error while loading.\n");
+        rc = -1;
+        goto done;
+    }
+
+    if (!chunks) {
+        while ((nf = csv_next_record(&pos, end, fields, CSV_MAX_FIELDS)) > 0) {
+            CsvRow r;
+            if (!csv_row_parse(fields, nf, col, &r)) continue;
+            int a = csv_row_add(r.sap, r.sap_len, r.name, r.name_len, r.course, r.course_len, r.marks, r.batch);
+            if (a == -2) duplicates++;
+            else if (a < 0) { rc = -1; break; }
+        }
+    }
+    if (chunks && (duplicates = load_chunks_add(chunks, nchunks)) < 0) rc = -1;
+    if (rc != 0) report_error("Memory error while loading.\n");
+    else {
+        db_stamp = file_mtime(filename);
+        report("Loaded %d students from %s\n", student_count, filename);
+        if (batch_count > 0) report("Restored the allocation of %d students.\n", rebuild_batch_members());
+        if (duplicates > 0) report("Skipped %d rows with duplicate SAP IDs.\n", duplicates);
+    }
+done:
+    for (int k = 0; chunks && k < nchunks; ++k) load_chunk_free(&chunks[k]);
+    stats_free(chunks);
+    csv_close(&cf);
+    return rc;
+}
+
+/* Replace the batch list with the definitions in a name,capacity CSV.
+ * A header row is recognised by its non-numeric capacity column. */
+static int load_batch_spec(const char *filename) {
+    if (!filename) return -1;
+    CsvFile cf;
+    if (csv_open(filename, &cf) != 0) { report_error("Could not open %s for reading.\n", filename); return -1; }
+
+    reset_allocations();
+    free_batches();
+
+    /* quoted names (as write_batch_sidecar writes them) may hold commas */
+    const char *pos = cf.data, *end = cf.data + cf.size;
+    CsvField fields[3];
+    int nf, lineno = 0, rc = 0;
+    while (rc == 0 && (nf = csv_next_record(&pos, end, fields, 3)) > 0) {
+        lineno++;
+        char name[MAX_LINE_LEN], cap[32], course[MAX_LINE_LEN];
+        if (csv_field_copy(&fields[0], name, sizeof name) == 0) continue;
+        char *cap_end = cap;
+        long capacity = 0;
+        if (nf >= 2) {
+            csv_field_copy(&fields[1], cap, sizeof cap);
+            capacity = strtol(cap, &cap_end, 10);
+        }
+        if (cap_end == cap) {
+            if (lineno == 1) continue;
+            report_error("%s:%d: missing batch capacity.\n", filename, lineno);
+            rc = -1;
+        } else if (capacity <= 0 || capacity > 1000000) {
+            report_error("%s:%d: capacity must be > 0.\n", filename, lineno);
+            rc = -1;
+        } else {
+            size_t clen = nf >= 3 ? csv_field_copy(&fields[2], course, sizeof course) : 0;
+            int cid = course_id(course, clen);
+            if (cid < -1 || append_batch(name, (int)capacity, cid) != 0) {
+                report_error("Memory error while loading.\n");
+                rc = -1;
+            }
+        }
+    }
+    csv_close(&cf);
+    if (rc == 0) report("Loaded %d batches from %s\n", batch_count, filename);
+    return rc;
+}
+
+/* Rebuild Batch.members from st_batch in one pass over the slots, after
+ * students were loaded with their stored assignments. Assignments past a
+ * batch's capacity (a hand-edited file) are dropped. Returns the number of
+ * students seated. */
+static int rebuild_batch_members(void) {
+    int seated = 0, dropped = 0;
+    for (int b = 0; b < batch_count; ++b) batches[b].filled = 0;
+    for (int i = 0; i < student_slots; ++i) {
+        st_member_pos[i] = -1;
+        int b = st_batch[i];
+        if (!student_alive(i) || b < 0) continue;
+        if (b >= batch_count || batches[b].filled >= batches[b].capacity) { st_batch[i] = -1; dropped++; continue; }
+        seat_in(i, b);
+        seated++;
+    }
+    if (dropped > 0) report("Dropped %d stored assignments that exceed batch capacity.\n", dropped);
+    return seated;
+}
+
+/* Replace the loaded preferences with a sap,choice1,choice2,... CSV, best
+ * choice first. Batch names are matched when the strategy runs, so the file
+ * can be loaded before the batches exist. */
+static int load_preferences(const char *filename) {
+    if (!filename) return -1;
+    CsvFile cf;
+    if (csv_open(filename, &cf) != 0) { report_error("Could not open %s for reading.\n", filename); return -1; }
+
+    free_preferences();
+    const char *pos = cf.data, *end = cf.data + cf.size;
+    CsvField fields[PREF_MAX + 1];
+    int nf, first = 1, truncated = 0;
+    while ((nf = csv_next_record(&pos, end, fields, PREF_MAX + 1)) > 0) {
+        int header = first && (csv_field_is(&fields[0], "sap") || csv_field_is(&fields[0], "roll"));
+        first = 0;
+        if (header || fields[0].len == 0) continue;
+        if (nf > PREF_MAX + 1) { nf = PREF_MAX + 1; truncated++; }
+
+        void *buf = pref_items;
+        if (grow_array(&buf, &pref_items_cap, pref_items_len + nf + 1, sizeof(uint32_t)) != 0) goto oom;
+        pref_items = buf;
+        char tmp[NAME_LEN];
+        size_t n = csv_field_copy(&fields[0], tmp, SAP_LEN);
+        uint32_t off = strpool_add(&pref_strs, tmp, n);
+        if (off == STRPOOL_NONE) goto oom;
+        int rec = pref_items_len, count = 0;
+        pref_items[rec] = off;
+        for (int f = 1; f < nf; ++f) {
+            if (fields[f].len == 0) continue;
+            n = csv_field_copy(&fields[f], tmp, sizeof tmp);
+            if ((off = strpool_intern(&pref_strs, tmp, n)) == STRPOOL_NONE) goto oom;
+            pref_items[rec + 2 + count++] = off;
+        }
+        pref_items[rec + 1] = (uint32_t)count;
+        pref_items_len = rec + 2 + count;
+        pref_records++;
+    }
+    csv_close(&cf);
+    report("Loaded preferences for %d students from %s\n", pref_records, filename);
+    if (truncated > 0) report("Kept only the first %d choices on %d rows.\n", PREF_MAX, truncated);
+    return 0;
+oom:
+    csv_close(&cf);
+    free_preferences();
+    report_error("Memory error while loading.\n");
+    return -1;
+}
+
+static void free_preferences(void) {
+    strpool_free(&pref_strs);
+    stats_free(pref_items);
+    pref_items = NULL;
+    pref_items_len = pref_items_cap = pref_records = 0;
+}
+
+/* ---------------- Merge Import ---------------- */
+
+/* Merging adds CSV rows to the students already loaded instead of
+ * replacing them. A SAP that is already present is resolved by policy:
+ * keep the record there, overwrite it with the incoming row, or take
+ * whichever is newer by file modification time (rows already loaded date
+ * from the last file loaded; ties keep the record there). Rows
+ * are matched through the SAP index, so a merge is one hash lookup per
+ * row on top of the parse. */
+typedef enum { MERGE_KEEP, MERGE_OVERWRITE, MERGE_NEWEST } MergePolicy;
+
+static const char *const merge_policy_names[] = { "keep", "overwrite", "newest" };
+
+typedef struct {
+    const char *file;
+    int rows, added, kept, replaced, same;
+    int unseated;             /* replaced rows whose course no longer fits their batch */
+    double seconds;
+} MergeFileReport;
+
+typedef struct {
+    MergePolicy policy;
+    long long stamp;          /* modification time of the file being merged */
+    long long *stamps;        /* per slot: time of the row it holds */
+    int stamp_cap;
+    MergeFileReport *rep;
+} MergeRun;
+
+/* Merge one row. Returns 0, or -1 on memory error. */
+static int merge_row(MergeRun *mr, const char *sap, size_t sap_len, const char *name, size_t name_len,
+                     const char *course, size_t course_len, int marks) {
+    MergeFileReport *rep = mr->rep;
+    rep->rows++;
+    int idx = find_student_by_sap(sap);
+    if (idx < 0) {
+        idx = csv_row_add(sap, sap_len, name, name_len, course, course_len, marks, -1);
+        if (idx < 0) return -1;
+        void *buf = mr->stamps;
+        int old_cap = mr->stamp_cap;
+        if (grow_array(&buf, &mr->stamp_cap, student_slots, sizeof(long long)) != 0) return -1;
+        mr->stamps = buf;
+        for (int i = old_cap; i < mr->stamp_cap; ++i) mr->stamps[i] = db_stamp;
+        mr->stamps[idx] = mr->stamp;
+        rep->added++;
+        return 0;
+    }
+    if (mr->policy == MERGE_KEEP || (mr->policy == MERGE_NEWEST && mr->stamp <= mr->stamps[idx])) {
+        rep->kept++;
+        return 0;
+    }
+    int cid = course_id(course, course_len);
+    if (cid < -1) return -1;
+    /* a loaded name is interned per load chunk only, so compare the text */
+    const char *old = student_name(idx);
+    int same_name = strlen(old) == name_len && memcmp(old, name, name_len) == 0;
+    uint32_t off = same_name ? st_name[idx] : strpool_intern(&student_strs, name, name_len);
+    if (off == STRPOOL_NONE) return -1;
+    mr->stamps[idx] = mr->stamp;
+    if (same_name && marks == st_marks[idx] && cid == st_course[idx]) { rep->same++; return 0; }
+    if (!same_name) {
+        st_name[idx] = off;
+        nameidx_remove(&name_index, idx);
+        name_index_add(idx);
+    }
+    /* a batch tagged for the old course must not keep a student of another */
+    int b = st_batch[idx];
+    if (cid != st_course[idx] && b >= 0 && batches[b].course >= 0 && batches[b].course != cid) {
+        unseat_student(idx);
+        rep->unseated++;
+    }
+    st_marks[idx] = marks;
+    st_course[idx] = cid;
+    rep->replaced++;
+    return 0;
+}
+
+/* Parse filename like read_csv_file (in chunks on all cores when large)
+ * and merge its rows in file order. Returns 0, or -1 if the file could
+ * not be read or memory ran out. */
+static int merge_csv_file(MergeRun *mr, const char *filename) {
+    CsvFile cf;
+    if (csv_open(filename, &cf) != 0) { report_error("Could not open %s for reading.\n", filename); return -1; }
+    const char *pos = cf.data, *end = cf.data + cf.size;
+    CsvField fields[CSV_MAX_FIELDS];
+    int nf = csv_next_record(&pos, end, fields, CSV_MAX_FIELDS);
+    if (nf == 0) { csv_close(&cf); return 0; }
+    int col[COL_COUNT];
+    map_csv_columns(fields, nf, col);
+
+    int threads = pool_default_threads();
+    size_t want = (size_t)(end - pos) / LOAD_CHUNK_BYTES;
+    if (want > (size_t)threads * 4) want = (size_t)threads * 4;
+    int nchunks = want < 2 ? 0 : want > LOAD_MAX_CHUNKS ? LOAD_MAX_CHUNKS : (int)want;
+    LoadChunk *chunks = NULL;
+    int rc = 0;
+    if (nchunks > 0) {
+        chunks = stats_malloc(sizeof(LoadChunk) * (size_t)nchunks);
+        if (!chunks || (nchunks = load_chunks_parse(chunks, nchunks, pos, end, col)) < 0) {
+            stats_free(chunks);
+            csv_close(&cf);
+            report_error("Memory error while merging.\n");
+            return -1;
+        }
+    }
+    size_t rows = 0;
+    if (chunks) for (int k = 0; k < nchunks; ++k) rows += (size_t)chunks[k].nrows;
+    else rows = csv_count_rows(pos, end);
+
+    /* every row may be new: size the columns and the SAP index once */
+    if (rows > (size_t)(INT32_MAX / 2 - student_slots)) { report_error("%s has too many rows.\n", filename); rc = -1; }
+    else if (rows > 0 && (reserve_students(student_slots + (int)rows) != 0 ||
+                          sap_index_reserve(student_count + (int)rows) != 0 ||
+                          strpool_reserve(&student_strs, cf.size) != 0)) rc = -1;
+
+    if (!chunks) {
+        while (rc == 0 && (nf = csv_next_record(&pos, end, fields, CSV_MAX_FIELDS)) > 0) {
+            CsvRow r;
+            if (!csv_row_parse(fields, nf, col, &r)) continue;
+            rc = merge_row(mr, r.sap, r.sap_len, r.name, r.name_len, r.course, r.course_len, r.marks);
+        }
+    }
+    for (int k = 0; chunks && k < nchunks; ++k) {
+        LoadChunk *c = &chunks[k];
+        const StrPool *sp = &c->strs;
+        for (int j = 0; j < c->nrows && rc == 0; ++j) {
+            const LoadRow *r = &c->rows[j];
+            const char *course = load_row_course(c, r);
+            rc = merge_row(mr, strpool_get(sp, r->sap), r->sap_len, strpool_get(sp, r->name), r->name_len,
+                           course, strlen(course), r->marks);
+        }
+        load_chunk_free(c);
+    }
+    if (rc != 0) report_error("Memory error while merging %s.\n", filename);
+    stats_free(chunks);
+    csv_close(&cf);
+    return rc;
+}
+
+/* Merge each file in turn into the loaded students, filling rep[i] for
+ * files[i]. Existing seats are kept, except where a replaced row moves a
+ * student to a course their batch does not serve; those students and the
+ * merged-in ones are unallocated until the next allocation. Returns 0, or
+ * -1 at the first file that fails (the files before it stay merged). */
+static int merge_csv_files(const char *const *files, int n, MergePolicy policy, MergeFileReport *rep) {
+    MergeRun mr = { policy, 0, NULL, 0, NULL };
+    int rc = 0;
+    void *buf = NULL;
+    for (int i = 0; i < n; ++i) {
+        memset(&rep[i], 0, sizeof rep[i]);
+        rep[i].file = files[i];
+    }
+    if (grow_array(&buf, &mr.stamp_cap, student_slots > 0 ? student_slots : 1, sizeof(long long)) != 0) {
+        report_error("Memory error while merging.\n");
+        return -1;
+    }
+    mr.stamps = buf;
+    for (int i = 0; i < mr.stamp_cap; ++i) mr.stamps[i] = db_stamp;
+    /* the order follows position and marks, and merged rows change both */
+    forget_allocation_order();
+    for (int i = 0; i < n && rc == 0; ++i) {
+        mr.rep = &rep[i];
+        mr.stamp = file_mtime(files[i]);
+        double t0 = stats_now();
+        rc = merge_csv_file(&mr, files[i]);
+        rep[i].seconds = stats_now() - t0;
+    }
+    stats_free(mr.stamps);
+    return rc;
+}
+
+/* One line per file plus totals */
+static void write_merge_report(FILE *f, const MergeFileReport *rep, int n, MergePolicy policy) {
+    MergeFileReport total = { "total", 0, 0, 0, 0, 0, 0, 0 };
+    fprintf(f, "Merge report (duplicates: %s)\n", merge_policy_names[policy]);
+    fprintf(f, "  %-28s %9s %9s %9s %9s %9s %9s %9s\n", "file", "rows", "added", "kept", "replaced", "same",
+            "unseated", "seconds");
+    for (int i = 0; i <= n; ++i) {
+        const MergeFileReport *r = i < n ? &rep[i] : &total;
+        if (i == n && n < 2) break;
+        fprintf(f, "  %-28s %9d %9d %9d %9d %9d %9d %9.4f\n", r->file, r->rows, r->added, r->kept, r->replaced,
+                r->same, r->unseated, r->seconds);
+        total.rows += r->rows; total.added += r->added; total.kept += r->kept;
+        total.replaced += r->replaced; total.same += r->same; total.unseated += r->unseated;
+        total.seconds += r->seconds;
+    }
+    fprintf(f, "  %d students now; merged-in students are unallocated until the next allocation.\n", student_count);
+    if (total.unseated > 0)
+        fprintf(f, "  %d replaced students left a batch that does not serve their new course.\n", total.unseated);
+}
+
+/* ---------------- Binary Snapshot ---------------- */
+
+/* A snapshot is the in-memory state written out column by column:
+ *
+ *   SnapHeader
+ *   st_marks[n] st_batch[n] st_course[n] st_sap[n] st_name[n] st_gen[n]   (int32/uint32)
+ *     (marks in hundredths; version 3 files hold whole marks and are scaled on load)
+ *   course_offs[courses]
+ *   SnapBatch[batches]
+ *   members[sum of filled]                                        (int32)
+ *   string pool bytes
+ *
+ * Every section is padded to 8 bytes. Loading maps the file, checks the
+ * header and checksum, validates every index and copies the sections
+ * back with memcpy; nothing is parsed. */
+
+#define SNAP_MAGIC "SRMSSNAP"
+#define SNAP_VERSION 4u
+#define SNAP_VERSION_WHOLE_MARKS 3u   /* same layout, marks in whole points */
+#define SNAP_ENDIAN 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;       /* SNAP_ENDIAN in the writer's byte order */
+    uint64_t checksum;     /* snap_checksum of everything after the header */
+    uint64_t payload_size;
+    int32_t student_count;  /* slots, including deleted ones */
+    int32_t batch_count;
+    int32_t course_count;
+    uint32_t generation;    /* journal generation folded in; 0 in older files */
+    uint64_t member_count;
+    uint64_t strings_size;
+} SnapHeader;
+
+typedef struct {
+    char name[32];
+    int32_t capacity;
+    int32_t filled;
+    int32_t course;
+} SnapBatch;
+
+/* the int columns are written as-is */
+_Static_assert(sizeof(int) == sizeof(int32_t), "snapshot layout assumes 32-bit int");
+
+static size_t snap_pad(size_t n) { return (n + 7) & ~(size_t)7; }
+
+/* Word-at-a-time FNV-style hash; len is always a multiple of 8 */
+static uint64_t snap_checksum(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+#define SNAP_SEED 14695981039346656037ull
+
+/* Streams the payload to disk while hashing it; a partial trailing word is
+ * held back in carry until it is completed or padded. */
+typedef struct {
+    FILE *f;
+    uint64_t h;
+    unsigned char carry[8];
+    size_t ncarry;
+    int err;
+} SnapWriter;
+
+static void snap_put(SnapWriter *w, const void *data, size_t len) {
+    const unsigned char *p = data;
+    if (w->err || len == 0) return;
+    if (fwrite(p, 1, len, w->f) != len) { w->err = 1; return; }
+    if (w->ncarry) {
+        size_t take = 8 - w->ncarry < len ? 8 - w->ncarry : len;
+        memcpy(w->carry + w->ncarry, p, take);
+        w->ncarry += take; p += take; len -= take;
+        if (w->ncarry < 8) return;
+        w->h = snap_checksum(w->h, w->carry, 8);
+        w->ncarry = 0;
+    }
+    size_t whole = len & ~(size_t)7;
+    w->h = snap_checksum(w->h, p, whole);
+    memcpy(w->carry, p + whole, len - whole);
+    w->ncarry = len - whole;
+}
+
+/* Zero-pad to the next 8-byte boundary (ends a section) */
+static void snap_align(SnapWriter *w) {
+    static const unsigned char zeros[8];
+    if (w->ncarry) snap_put(w, zeros, 8 - w->ncarry);
+}
+
+static int write_snapshot_file(const char *filename) {
+    if (!filename) return -1;
+    char tmpname[1024];
+    snprintf(tmpname, sizeof tmpname, "%s.tmp", filename);
+    FILE *f = fopen(tmpname, "wb");
+    if (!f) { report_error("Could not open %s for writing.\n", tmpname); return -1; }
+
+    SnapHeader hdr;
+    memset(&hdr, 0, sizeof hdr);
+    memcpy(hdr.magic, SNAP_MAGIC, 8);
+    hdr.version = SNAP_VERSION;
+    hdr.endian = SNAP_ENDIAN;
+    hdr.student_count = student_slots;
+    hdr.batch_count = batch_count;
+    hdr.course_count = course_count;
+    hdr.generation = snap_generation;
+    hdr.strings_size = student_strs.len;
+    for (int b = 0; b < batch_count; ++b) hdr.member_count += (uint64_t)batches[b].filled;
+
+    size_t n = (size_t)student_slots;
+    SnapWriter w = { f, SNAP_SEED, {0}, 0, 0 };
+    if (fwrite(&hdr, sizeof hdr, 1, f) != 1) w.err = 1;
+    snap_put(&w, st_marks, n * sizeof(int32_t)); snap_align(&w);
+    snap_put(&w, st_batch, n * sizeof(int32_t)); snap_align(&w);
+    snap_put(&w, st_course, n * sizeof(int32_t)); snap_align(&w);
+    snap_put(&w, st_sap, n * sizeof(uint32_t)); snap_align(&w);
+    snap_put(&w, st_name, n * sizeof(uint32_t)); snap_align(&w);
+    snap_put(&w, st_gen, n * sizeof(uint32_t)); snap_align(&w);
+    snap_put(&w, course_offs, (size_t)course_count * sizeof(uint32_t)); snap_align(&w);
+    for (int b = 0; b < batch_count; ++b) {
+        SnapBatch sb;
+        memset(&sb, 0, sizeof sb);
+        safe_strdup_truncate(sb.name, batches[b].name, sizeof sb.name);
+        sb.capacity = batches[b].capacity;
+        sb.filled = batches[b].filled;
+        sb.course = batches[b].course;
+        snap_put(&w, &sb, sizeof sb);
+    }
+    snap_align(&w);
+    for (int b = 0; b < batch_count; ++b)
+        snap_put(&w, batches[b].members, (size_t)batches[b].filled * sizeof(int32_t));
+    snap_align(&w);
+    snap_put(&w, student_strs.buf, student_strs.len); snap_align(&w);
+
+    int err = w.err;
+    if (!err) {
+        long end = ftell(f);
+        hdr.payload_size = (uint64_t)end - sizeof hdr;
+        hdr.checksum = w.h;
+        err = end < 0 || fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof hdr, 1, f) != 1;
+    }
+    if (fclose(f) != 0) err = 1;
+    if (err || rename(tmpname, filename) != 0) {
+        remove(tmpname);
+        report_error("Error while writing %s.\n", filename);
+        return -1;
+    }
+    report("Saved snapshot of %d students and %d batches to %s\n", student_count, batch_count, filename);
+    return 0;
+}
+
+/* Bounds-checked cursor over the mapped payload */
+static const void *snap_take(const char **pos, const char *end, size_t len) {
+    size_t padded = snap_pad(len);
+    if ((size_t)(end - *pos) < padded) return NULL;
+    const void *p = *pos;
+    *pos += padded;
+    return p;
+}
+
+static int read_snapshot_file(const char *filename) {
+    if (!filename) return -1;
+    CsvFile cf;
+    if (csv_open(filename, &cf) != 0) { report_error("Could not open %s for reading.\n", filename); return -1; }
+
+    SnapHeader hdr;
+    memset(&hdr, 0, sizeof hdr);
+    const char *why = NULL;
+    if (cf.size < sizeof hdr) why = "file too short";
+    else {
+        memcpy(&hdr, cf.data, sizeof hdr);
+        if (memcmp(hdr.magic, SNAP_MAGIC, 8) != 0) why = "not a snapshot";
+        else if (hdr.endian != SNAP_ENDIAN) why = "written on a machine with a different byte order";
+        else if (hdr.version != SNAP_VERSION && hdr.version != SNAP_VERSION_WHOLE_MARKS) why = "unsupported version";
+        else if (hdr.payload_size != cf.size - sizeof hdr || hdr.payload_size % 8) why = "truncated";
+        else if (snap_checksum(SNAP_SEED, cf.data + sizeof hdr, hdr.payload_size) != hdr.checksum) why = "checksum mismatch";
+        else if (hdr.student_count < 0 || hdr.batch_count < 0 || hdr.course_count < 0) why = "corrupt header";
+    }
+
+    const char *pos = cf.data + sizeof hdr, *end = cf.data + cf.size;
+    size_t n = why ? 0 : (size_t)hdr.student_count;
+    size_t nc = why ? 0 : (size_t)hdr.course_count, nb = why ? 0 : (size_t)hdr.batch_count;
+    const int32_t *marks = NULL, *batch = NULL, *course = NULL, *members = NULL;
+    const uint32_t *sap = NULL, *name = NULL, *gen = NULL, *coffs = NULL;
+    const SnapBatch *sbs = NULL;
+    const char *strs = NULL;
+    if (!why) {
+        marks = snap_take(&pos, end, n * 4);
+        batch = snap_take(&pos, end, n * 4);
+        course = snap_take(&pos, end, n * 4);
+        sap = snap_take(&pos, end, n * 4);
+        name = snap_take(&pos, end, n * 4);
+        gen = snap_take(&pos, end, n * 4);
+        coffs = snap_take(&pos, end, nc * 4);
+        sbs = snap_take(&pos, end, nb * sizeof(SnapBatch));
+        members = snap_take(&pos, end, hdr.member_count * 4);
+        strs = snap_take(&pos, end, hdr.strings_size);
+        if (!marks || !batch || !course || !sap || !name || !gen || !coffs || !sbs || !members || !strs ||
+            hdr.strings_size > UINT32_MAX || (hdr.strings_size > 0 && strs[hdr.strings_size - 1] != '\0'))
+            why = "corrupt section table";
+    }
+    /* every offset and index must land inside the data it refers to */
+    uint64_t total_filled = 0;
+    for (size_t i = 0; i < nb && !why; ++i) {
+        if (sbs[i].capacity <= 0 || sbs[i].filled < 0 || sbs[i].filled > sbs[i].capacity ||
+            sbs[i].course < -1 || sbs[i].course >= (int32_t)nc) why = "corrupt batch";
+        else total_filled += (uint64_t)sbs[i].filled;
+    }
+    if (!why && total_filled != hdr.member_count) why = "corrupt batch";
+    for (size_t i = 0; i < n && !why; ++i) {
+        if (sap[i] >= hdr.strings_size || name[i] >= hdr.strings_size ||
+            batch[i] < -1 || batch[i] >= (int32_t)nb || course[i] < -1 || course[i] >= (int32_t)nc ||
+            (!(gen[i] & 1u) && batch[i] != -1))
+            why = "corrupt student record";
+    }
+    for (size_t i = 0; i < nc && !why; ++i) if (coffs[i] >= hdr.strings_size) why = "corrupt course table";
+    for (uint64_t i = 0; i < hdr.member_count && !why; ++i) {
+        if (members[i] < 0 || (size_t)members[i] >= n || !(gen[members[i]] & 1u)) why = "corrupt batch member";
+    }
+    if (why) {
+        report_error("Cannot load %s: %s.\n", filename, why);
+        csv_close(&cf);
+        return -1;
+    }
+
+    free_batches();
+    clear_students();
+    if (reserve_students((int)n) != 0 || strpool_reserve(&student_strs, hdr.strings_size) != 0 ||
+        reserve_batches((int)nb) != 0 || sap_index_reserve((int)n) != 0) {
+        report_error("Memory error while loading.\n");
+        csv_close(&cf);
+        return -1;
+    }
+    memcpy(st_marks, marks, n * 4);
+    for (size_t i = 0; hdr.version == SNAP_VERSION_WHOLE_MARKS && i < n; ++i) {
+        int m = st_marks[i];
+        st_marks[i] = m > INT32_MAX / MARKS_SCALE ? INT32_MAX : m < INT32_MIN / MARKS_SCALE ? INT32_MIN : m * MARKS_SCALE;
+    }
+    memcpy(st_batch, batch, n * 4);
+    memcpy(st_course, course, n * 4);
+    memcpy(st_sap, sap, n * 4);
+    memcpy(st_name, name, n * 4);
+    memcpy(st_gen, gen, n * 4);
+    memcpy(student_strs.buf, strs, hdr.strings_size);
+    student_strs.len = hdr.strings_size;
+    student_slots = (int)n;
+
+    /* dead slots go back on the free list */
+    int err = 0;
+    for (size_t i = 0; i < n && !err; ++i) {
+        st_member_pos[i] = -1;
+        if (gen[i] & 1u) { student_count++; continue; }
+        void *fbuf = free_slots;
+        err = grow_array(&fbuf, &free_cap, free_count + 1, sizeof(int)) != 0;
+        free_slots = fbuf;
+        if (!err) free_slots[free_count++] = (int)i;
+    }
+
+    /* course ids must keep resolving through the intern table */
+    void *cbuf = course_offs;
+    err = err || grow_array(&cbuf, &course_cap, (int)nc, sizeof(uint32_t)) != 0;
+    course_offs = cbuf;
+    for (size_t i = 0; i < nc && !err; ++i) {
+        course_offs[i] = coffs[i];
+        err = strpool_register(&student_strs, coffs[i]) != 0;
+    }
+    course_count = (int)nc;
+
+    const int32_t *m = members;
+    for (size_t i = 0; i < nb && !err; ++i) {
+        err = append_batch(sbs[i].name, sbs[i].capacity, sbs[i].course) != 0;
+        if (err) break;
+        memcpy(batches[i].members, m, (size_t)sbs[i].filled * 4);
+        batches[i].filled = sbs[i].filled;
+        for (int j = 0; j < sbs[i].filled; ++j) st_member_pos[m[j]] = j;
+        m += sbs[i].filled;
+    }
+    csv_close(&cf);
+
+    sap_index_rebuild();
+    if (err || sap_used != student_count) {
+        report_error(err ? "Memory error while loading.\n" : "Cannot load %s: duplicate SAP IDs.\n", filename);
+        return -1;
+    }
+    snap_generation = hdr.generation;
+    db_stamp = file_mtime(filename);
+    report("Loaded snapshot of %d students and %d batches from %s\n", student_count, batch_count, filename);
+    return 0;
+}
+
+/* ---------------- Journal ---------------- */
+
+/* Interactive admin edits are appended to srms.journal as they happen, one
+ * record per change of state, and synced once per edit (a bulk delete is
+ * one sync). At startup the journal is replayed on top of srms.snap, so
+ * edits survive a crash without a save. The records carry outcomes, not
+ * intents: a student re-seated by incremental maintenance gets a seat
+ * record, so replay needs neither the allocation order nor the strategy.
+ *
+ * Journal and snapshot are matched by generation. Folding the journal in
+ * (a checkpoint) writes srms.snap stamped one generation past the journal's
+ * base and starts an empty journal on that, so whichever of the two steps
+ * a crash interrupts, startup sees either a journal that still applies or
+ * one older than the snapshot, which is dropped. Allocations and loads
+ * replace the state wholesale and checkpoint straight away. A journal that
+ * outgrows a fraction of the snapshot is folded in the background: it is
+ * set aside as srms.journal.old, a fresh one takes the edits, and a forked
+ * child writes the snapshot from its copy-on-write image. */
+
+enum { WAL_STUDENT = 1, WAL_DELETE, WAL_SEAT, WAL_BATCH };
+
+/* Fold in the background once the journal passes this and a quarter of
+ * the snapshot it would replace */
+#define WAL_COMPACT_MIN (256 * 1024)
+
+static void wal_log_student(int idx) {
+    if (!journal_on) return;
+    journal_begin(&journal, WAL_STUDENT);
+    journal_put_str(&journal, student_sap(idx));
+    journal_put_str(&journal, student_name(idx));
+    journal_put_int(&journal, st_marks[idx]);
+    journal_put_str(&journal, student_course(idx));
+    journal_put_int(&journal, st_batch[idx]);
+    journal_end(&journal);
+}
+
+static void wal_log_delete(int idx) {
+    if (!journal_on) return;
+    journal_begin(&journal, WAL_DELETE);
+    journal_put_str(&journal, student_sap(idx));
+    journal_end(&journal);
+}
+
+static void wal_log_seat(int idx) {
+    if (!journal_on) return;
+    journal_begin(&journal, WAL_SEAT);
+    journal_put_str(&journal, student_sap(idx));
+    journal_put_int(&journal, st_batch[idx]);
+    journal_end(&journal);
+}
+
+static void wal_log_batch(int b) {
+    if (!journal_on) return;
+    journal_begin(&journal, WAL_BATCH);
+    journal_put_str(&journal, batches[b].name);
+    journal_put_int(&journal, batches[b].capacity);
+    journal_put_str(&journal, course_name(batches[b].course));
+    journal_end(&journal);
+}
+
+/* Move idx to batch b (-1: none). Returns 0, or -1 if b is out of range
+ * or full. */
+static int wal_reseat(int idx, int b) {
+    if (b < -1 || b >= batch_count) return -1;
+    if (st_batch[idx] == b) return 0;
+    unseat_student(idx);
+    if (b < 0) return 0;
+    if (batches[b].filled >= batches[b].capacity) return -1;
+    seat_in(idx, b);
+    return 0;
+}
+
+static int wal_apply(int type, JournalReader *r, void *ctx) {
+    (void)ctx;
+    char sap[SAP_LEN], name[NAME_LEN], course[NAME_LEN];
+    if (type == WAL_STUDENT) {
+        journal_get_str(r, sap, sizeof sap);
+        journal_get_str(r, name, sizeof name);
+        int marks = journal_get_int(r);
+        journal_get_str(r, course, sizeof course);
+        int batch = journal_get_int(r);
+        int cid = course_id(course, strlen(course));
+        if (r->bad || cid < -1) return -1;
+        int idx = find_student_by_sap(sap);
+        if (idx < 0) {
+            idx = append_student(sap, strlen(sap), name, strlen(name), marks, cid, -1);
+            if (idx < 0) return -1;
+        } else {
+            uint32_t off = strpool_intern(&student_strs, name, strlen(name));
+            if (off == STRPOOL_NONE) return -1;
+            if (off != st_name[idx]) {
+                st_name[idx] = off;
+                nameidx_remove(&name_index, idx);
+                name_index_add(idx);
+            }
+            st_marks[idx] = marks;
+            st_course[idx] = cid;
+        }
+        return wal_reseat(idx, batch);
+    }
+    if (type == WAL_DELETE || type == WAL_SEAT) {
+        journal_get_str(r, sap, sizeof sap);
+        int batch = type == WAL_SEAT ? journal_get_int(r) : -1;
+        int idx = find_student_by_sap(sap);
+        if (r->bad || idx < 0) return -1;
+        if (type == WAL_SEAT) return wal_reseat(idx, batch);
+        remove_student(idx);
+        return 0;
+    }
+    if (type == WAL_BATCH) {
+        journal_get_str(r, name, sizeof name);
+        int capacity = journal_get_int(r);
+        journal_get_str(r, course, sizeof course);
+        int cid = course_id(course, strlen(course));
+        if (r->bad || capacity <= 0 || cid < -1) return -1;
+        return append_batch(name, capacity, cid);
+    }
+    return -1;
+}
+
+/* Replays path if it applies to generation *gen, advancing *gen past it
+ * when it is a set-aside journal (the live one keeps its base). Stale
+ * journals are removed; ones from the future are kept out of the way.
+ * Returns 1 if replayed, 0 if not. */
+static int wal_replay_file(const char *path, uint32_t *gen, int live, uint64_t *valid, int *records) {
+    uint32_t base;
+    int rc = journal_peek(path, &base);
+    if (rc == -1) return 0;
+    if (rc == 0 && base < *gen) { remove(path); return 0; }
+    if (rc != 0 || base > *gen) {
+        rename(path, JOURNAL_UNAPPLIED_FILE);
+        report_error("%s does not match the loaded data; kept as %s.\n", path, JOURNAL_UNAPPLIED_FILE);
+        return 0;
+    }
+    int failed;
+    *records = journal_replay(path, &base, valid, &failed, wal_apply, NULL);
+    if (*records < 0) return 0;
+    if (*records > 0) report("Replayed %d journaled edits from %s.\n", *records, path);
+    if (failed > 0) report_error("%d journaled edits no longer applied and were skipped.\n", failed);
+    if (!live) *gen = base + 1;
+    return 1;
+}
+
+/* After loading srms.snap (or students.csv): replay what the journal holds
+ * on top and keep journaling */
+static void wal_start(void) {
+    uint32_t gen = snap_generation;
+    uint64_t valid = 0;
+    int records = 0;
+    int folded = wal_replay_file(JOURNAL_OLD_FILE, &gen, 0, &valid, &records);
+    int resumed = wal_replay_file(JOURNAL_FILE, &gen, 1, &valid, &records);
+    if (resumed ? journal_resume(&journal, JOURNAL_FILE, gen, valid, records) != 0
+                : journal_create(&journal, JOURNAL_FILE, gen) != 0) {
+        report_error("Could not open %s; edits will not be journaled.\n", JOURNAL_FILE);
+        return;
+    }
+    snap_generation = gen;
+    journal_on = 1;
+    /* a crash interrupted the last fold: finish it */
+    if (folded) wal_checkpoint();
+}
+
+/* The snapshot half of a background fold, run in the forked child */
+static int wal_snapshot_task(void *ctx) {
+    (void)ctx;
+    headless = 1;
+    return write_snapshot_file(SNAPSHOT_FILE);
+}
+
+/* A background fold finished (ok) or failed */
+static void wal_folded(int ok) {
+    if (ok) { remove(JOURNAL_OLD_FILE); return; }
+    report_error("Background snapshot of the journal failed; writing it now.\n");
+    wal_checkpoint();
+}
+
+/* Set the journal aside and fold it into srms.snap in a child process.
+ * The live journal starts over on the next generation, which is what the
+ * child stamps into the snapshot. */
+static void wal_compact(void) {
+    if (journal.child || file_exists(JOURNAL_OLD_FILE)) return;
+    if (rename(JOURNAL_FILE, JOURNAL_OLD_FILE) != 0) return;
+    Journal fresh = { .fd = -1 };
+    if (journal_create(&fresh, JOURNAL_FILE, journal.base + 1) != 0) {
+        rename(JOURNAL_OLD_FILE, JOURNAL_FILE);
+        return;
+    }
+    journal_close(&journal);
+    journal = fresh;
+    snap_generation = journal.base;
+    if (journal_fork(&journal, wal_snapshot_task, NULL) == 0) return;
+    wal_folded(write_snapshot_file(SNAPSHOT_FILE) == 0);
+}
+
+/* Make the edits logged since the last commit durable */
+static void wal_commit(void) {
+    if (!journal_on) return;
+    int r = journal_reap(&journal, 0);
+    if (r != 0) wal_folded(r > 0);
+    if (journal_commit(&journal) != 0) {
+        report_error("Could not write %s; save a snapshot to keep these edits.\n", JOURNAL_FILE);
+        return;
+    }
+    uint64_t snap_bytes = (uint64_t)student_slots * 24 + student_strs.len;
+    if (journal.size > WAL_COMPACT_MIN && journal.size > snap_bytes / 4) wal_compact();
+}
+
+/* Fold everything into srms.snap now and start an empty journal. Returns
+ * 0, or -1 if the snapshot could not be written (the journal still holds
+ * every edit). */
+static int wal_checkpoint(void) {
+    if (!journal_on) return 0;
+    int r = journal_reap(&journal, 1);
+    if (r > 0) remove(JOURNAL_OLD_FILE);
+    uint32_t prev = snap_generation;
+    snap_generation = journal.base + 1;
+    if (save_snapshot(SNAPSHOT_FILE) != 0) {
+        snap_generation = prev;
+        report_error("Edits are still journaled in %s.\n", JOURNAL_FILE);
+        return -1;
+    }
+    if (journal_create(&journal, JOURNAL_FILE, snap_generation) != 0) {
+        journal_on = 0;
+        report_error("Could not restart %s; further edits are not journaled.\n", JOURNAL_FILE);
+        return 0;
+    }
+    remove(JOURNAL_OLD_FILE);
+    return 0;
+}
+
+/* At exit: wait for a background fold and close */
+static void wal_stop(void) {
+    if (!journal_on) return;
+    journal_commit(&journal);
+    int r = journal_reap(&journal, 1);
+    if (r != 0) wal_folded(r > 0);
+    journal_close(&journal);
+    journal_on = 0;
+}
+
+/* ---------------- Student Access ---------------- */
+
+#define NAME_MATCHES_MAX 20
+
+static void show_student(int idx) {
+    char mk[16];
+    printf("SAP: %s\nName: %s\nMarks: %s\n", student_sap(idx), student_name(idx), format_marks(st_marks[idx], mk));
+    if (st_course[idx] >= 0) printf("Course: %s\n", student_course(idx));
+    int b = st_batch[idx];
+    if (b >= 0 && b < batch_count) printf("Allocated Batch: %s (index %d)\n", batches[b].name, b);
+    else printf("Allocated Batch: Not allocated\n");
+}
+
+/* No SAP matched: list the students with a name word starting with the
+ * query or, failing that, names within a typo or two of it */
+static void find_students_by_name(const char *query) {
+    if (!name_index.built && name_index_rebuild() != 0) { printf("Memory error.\n"); return; }
+    /* one past the limit tells whether there are more */
+    int slots[NAME_MATCHES_MAX + 1];
+    int total = nameidx_prefix(&name_index, query, slots, NAME_MATCHES_MAX + 1);
+    const char *how = "starting with";
+    if (total == 0) {
+        NameHit hits[NAME_MATCHES_MAX];
+        total = nameidx_fuzzy(&name_index, query, strlen(query) >= 6 ? 2 : 1, hits, NAME_MATCHES_MAX);
+        if (total < 0) { printf("Memory error.\n"); return; }
+        for (int i = 0; i < total; ++i) slots[i] = hits[i].slot;
+        how = "close to";
+    }
+    if (total == 0) { printf("Student not found.\n"); return; }
+    if (total == 1) { show_student(slots[0]); return; }
+
+    int shown = total < NAME_MATCHES_MAX ? total : NAME_MATCHES_MAX;
+    if (total > NAME_MATCHES_MAX)
+        printf("More than %d students have a name %s \"%s\"; the first %d:\n", NAME_MATCHES_MAX, how, query, shown);
+    else printf("%d students have a name %s \"%s\":\n", total, how, query);
+    print_separator();
+    printf("%-10s  %-30s  %-6s\n", "SAP", "Name", "Batch");
+    print_separator();
+    for (int i = 0; i < shown; ++i) {
+        int b = st_batch[slots[i]];
+        printf("%-10s  %-30s  %-6s\n", student_sap(slots[i]), student_name(slots[i]),
+               b >= 0 && b < batch_count ? batches[b].name : "-");
+    }
+    print_separator();
+    printf("Enter a SAP ID for the full record.\n");
+}
+
+static void student_access(void) {
+    char query[NAME_LEN];
+    printf("Enter SAP ID or name: ");
+    if (!fgets(query, sizeof query, stdin)) return;
+    query[strcspn(query, "\n")] = '\0';
+    if (query[0] == '\0') { printf("Student not found.\n"); return; }
+    int idx = find_student_by_sap(query);
+    if (idx >= 0) show_student(idx);
+    else find_students_by_name(query);
+}
+
+/* ---------------- Instrumentation ---------------- */
+
+/* Phases may nest (a strategy sorts inside its allocate phase); only the
+ * outermost one resets the peak-memory watermark, so an inner phase reports
+ * the peak of the enclosing operation so far. */
+static void phase_begin(PhaseMark *m) {
+    if (phase_depth++ == 0) phase_peak_scoped = stats_peak_reset();
+    m->t0 = stats_now();
+    m->allocs0 = atomic_load(&stats_allocs);
+}
+
+/* Records the operation as the latest of its phase if it succeeded */
+static void phase_end(Phase p, const PhaseMark *m, int rc, const char *op, const char *detail,
+                      uint64_t items, uint64_t comparisons) {
+    double secs = stats_now() - m->t0;
+    phase_depth--;
+    if (rc != 0) return;
+    PhaseStats *ps = &phase_stats[p];
+    ps->valid = 1;
+    if (detail) snprintf(ps->op, sizeof ps->op, "%s %s", op, detail);
+    else snprintf(ps->op, sizeof ps->op, "%s", op);
+    ps->seconds = secs;
+    ps->items = items;
+    ps->comparisons = comparisons;
+    ps->allocs = atomic_load(&stats_allocs) - m->allocs0;
+    ps->peak_kb = stats_peak_kb();
+    ps->peak_scoped = phase_peak_scoped;
+}
+
+/* The loads below replace the database only when they succeed (see
+ * StudentDb); the old one is held until then, so the peak is both. */
+static int load_csv(const char *filename) {
+    PhaseMark m;
+    phase_begin(&m);
+    StudentDb old;
+    db_stash(&old);
+    int rc = read_csv_file(filename);
+    if (rc != 0 && old.count > 0) report_error("Keeping the %d students loaded before.\n", old.count);
+    if (rc != 0) db_restore(&old);
+    else db_free(&old);
+    phase_end(PHASE_LOAD, &m, rc, "load csv", filename, (uint64_t)student_count, 0);
+    return rc;
+}
+
+static int merge_csv(const char *const *files, int n, MergePolicy policy, MergeFileReport *rep) {
+    PhaseMark m;
+    phase_begin(&m);
+    int rc = merge_csv_files(files, n, policy, rep);
+    uint64_t rows = 0;
+    for (int i = 0; i < n; ++i) rows += (uint64_t)rep[i].rows;
+    char detail[64];
+    snprintf(detail, sizeof detail, "%d file%s, %s", n, n == 1 ? "" : "s", merge_policy_names[policy]);
+    phase_end(PHASE_LOAD, &m, rc, "merge csv", detail, rows, 0);
+    return rc;
+}
+
+static int save_csv(const char *filename) {
+    PhaseMark m;
+    phase_begin(&m);
+    int rc = write_csv_file(filename);
+    phase_end(PHASE_SAVE, &m, rc, "save csv", filename, (uint64_t)student_count, 0);
+    return rc;
+}
+
+static int save_rosters(const char *filename) {
+    PhaseMark m;
+    phase_begin(&m);
+    int rc = write_rosters_file(filename);
+    phase_end(PHASE_SAVE, &m, rc, "save rosters", filename, (uint64_t)student_count, 0);
+    return rc;
+}
+
+/* The strategy comparison, to filename or stdout for "-" */
+static int save_comparison(const char *filename) {
+    FILE *f = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (!f) { report_error("Could not open %s for writing.\n", filename); return -1; }
+    int rc = compare_strategies(f);
+    if (f != stdout && fclose(f) != 0) rc = -1;
+    return rc;
+}
+
+static int load_snapshot(const char *filename) {
+    PhaseMark m;
+    phase_begin(&m);
+    StudentDb old;
+    db_stash(&old);
+    int rc = read_snapshot_file(filename);
+    if (rc != 0 && old.count > 0) report_error("Keeping the %d students loaded before.\n", old.count);
+    if (rc != 0) db_restore(&old);
+    else db_free(&old);
+    phase_end(PHASE_LOAD, &m, rc, "load snapshot", filename, (uint64_t)student_count, 0);
+    return rc;
+}
+
+static int save_snapshot(const char *filename) {
+    PhaseMark m;
+    phase_begin(&m);
+    int rc = write_snapshot_file(filename);
+    phase_end(PHASE_SAVE, &m, rc, "save snapshot", filename, (uint64_t)student_count, 0);
+    return rc;
+}
+
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/* The Summary Report's phase table as one JSON object; "-" writes to stderr */
+static int write_phase_json(const char *filename) {
+    FILE *f = strcmp(filename, "-") == 0 ? stderr : fopen(filename, "w");
+    if (!f) { report_error("Could not open %s for writing.\n", filename); return -1; }
+    fprintf(f, "{\"students\":%d,\"batches\":%d,", student_count, batch_count);
+    /* the seed is a string: JSON readers may round integers past 2^53 */
+    if (random_last.valid) {
+        fprintf(f, "\"random\":{\"seed\":\"%llu\",\"trials\":%d,\"placement\":\"%s\"",
+                (unsigned long long)random_last.seed, random_last.trials,
+                random_last.proportional ? "proportional" : "round-robin");
+        if (random_last.trials > 1)
+            fprintf(f, ",\"best_trial\":%d,\"score\":%.6f,\"mean_score\":%.6f", random_last.best,
+                    random_last.score, random_last.mean_score);
+        fprintf(f, "},");
+    }
+    fprintf(f, "\"phases\":[");
+    int first = 1;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        const PhaseStats *ps = &phase_stats[p];
+        if (!ps->valid) continue;
+        fprintf(f, "%s\n  {\"phase\":\"%s\",\"op\":", first ? "" : ",", phase_names[p]);
+        json_string(f, ps->op);
+        fprintf(f, ",\"seconds\":%.6f,\"items\":%llu,\"comparisons\":%llu,\"allocations\":%llu,"
+                   "\"peak_rss_kb\":%ld,\"peak_scope\":\"%s\"}",
+                ps->seconds, (unsigned long long)ps->items, (unsigned long long)ps->comparisons,
+                (unsigned long long)ps->allocs, ps->peak_kb, ps->peak_scoped ? "phase" : "process");
+        first = 0;
+    }
+    fprintf(f, "%s]}\n", first ? "" : "\n");
+    int rc = ferror(f) ? -1 : 0;
+    if (f == stderr) fflush(f);
+    else if (fclose(f) != 0) rc = -1;
+    if (rc != 0) report_error("Error writing %s.\n", filename);
+    else if (f != stderr) report("Timing stats written to %s\n", filename);
+    return rc;
+}
+
+/* ---------------- Strategy Table ---------------- */
+
+typedef struct {
+    const char *name;
+    int (*run)(void);
+} StrategyEntry;
+
+static int allocation_az(void) { return allocation_alphabetical(0); }
+static int allocation_za(void) { return allocation_alphabetical(1); }
+
+static const StrategyEntry strategies[] = {
+    { "marks",  allocation_by_marks },
+    { "az",     allocation_az },
+    { "za",     allocation_za },
+    { "sap",    allocation_by_sap_asc },
+    { "random", allocation_random },
+    { "balanced", allocation_balanced },
+    { "prefs",  allocation_by_preference },
+};
+
+/* Runs one strategy as the allocate phase; its sorting shows up separately */
+static int run_strategy(const StrategyEntry *se) {
+    PhaseMark m;
+    phase_begin(&m);
+    alloc_comparisons = 0;
+    int rc = se->run();
+    char what[64];
+    int ordered = se->run != allocation_balanced && se->run != allocation_by_preference;
+    snprintf(what, sizeof what, "%s%s%s", se->name, course_partitioned ? " (by course)" : "",
+             ordered && proportional_placement ? " (proportional)" : "");
+    phase_end(PHASE_ALLOCATE, &m, rc, "allocate", what, (uint64_t)student_count, alloc_comparisons);
+    return rc;
+}
+
+/* ---------------- Admin Menu ---------------- */
+
+static void set_random_interactive(void) {
+    char line[32];
+    printf("Shuffles to score per random allocation (1-%d, 1 = plain shuffle): ", RANDOM_TRIALS_MAX);
+    if (!fgets(line, sizeof line, stdin)) return;
+    int k = atoi(line);
+    if (k >= 1 && k <= RANDOM_TRIALS_MAX) random_trials = k;
+    else printf("Keeping %d.\n", random_trials);
+    printf("Seed for the next random allocation (press Enter for a fresh one): ");
+    if (!fgets(line, sizeof line, stdin)) return;
+    line[strcspn(line, "\n")] = '\0';
+    if (strlen(line) == 0) { random_seeded = 0; return; }
+    char *end;
+    unsigned long long v = strtoull(line, &end, 10);
+    if (*end || line[0] == '-') { printf("Invalid seed; a fresh one will be used.\n"); random_seeded = 0; return; }
+    random_next_seed = v;
+    random_seeded = 1;
+}
+
+/* File names one per line, then the duplicate policy */
+static void merge_interactive(void) {
+    char names[MERGE_FILES_MAX][128];
+    const char *files[MERGE_FILES_MAX];
+    int n = 0;
+    printf("Enter CSV files to merge, one per line (blank line to finish):\n");
+    while (n < MERGE_FILES_MAX) {
+        printf("File %d: ", n + 1);
+        if (!fgets(names[n], sizeof names[n], stdin)) break;
+        names[n][strcspn(names[n], "\n")] = '\0';
+        if (strlen(names[n]) == 0) break;
+        files[n] = names[n];
+        n++;
+    }
+    if (n == 0) { printf("No files given.\n"); return; }
+    printf("When a SAP is already present:\n1. Keep the existing record\n2. Overwrite with the merged row\n");
+    printf("3. Keep the newest (by file modification time)\nSelect: ");
+    int p;
+    if (scanf("%d", &p) != 1) { clear_input(); printf("Invalid choice.\n"); return; }
+    clear_input();
+    if (p < 1 || p > 3) { printf("Invalid choice.\n"); return; }
+    MergeFileReport rep[MERGE_FILES_MAX];
+    merge_csv(files, n, (MergePolicy)(p - 1), rep);
+    write_merge_report(stdout, rep, n, (MergePolicy)(p - 1));
+    /* files merged before a failure stay merged, so fold them in either way */
+    wal_checkpoint();
+}
+
+static void admin_menu(void) {
+    for (;;) {
+        printf("\n--- Admin Menu ---\n");
+        printf("1. Add student(s)\n2. View students\n3. Update student\n4. Delete student\n");
+        printf("5. Add batch\n6. View batches\n7. Allocate batches\n8. Save database to CSV\n");
+        printf("9. Load database from CSV\n10. Summary Report\n11. Save snapshot\n12. Load snapshot\n");
+        printf("13. Delete students listed in a file\n14. Load batch preferences\n15. Export timing stats (JSON)\n");
+        printf("16. Export batch rosters to CSV\n17. Merge CSV files into the database\n18. Back to Main Menu\n");
+        printf("Choose option: ");
+        int ch;
+        if (scanf("%d", &ch) != 1) { clear_input(); continue; }
+        clear_input();
+        if (ch == 1) add_student_interactive();
+        else if (ch == 2) view_students();
+        else if (ch == 3) update_student();
+        else if (ch == 4) delete_student();
+        else if (ch == 5) add_batch();
+        else if (ch == 6) view_batches();
+        else if (ch == 7) {
+            if (batch_count == 0) { printf("No batches defined. Add batches first.\n"); continue; }
+            if (student_count == 0) { printf("No students available to allocate.\n"); continue; }
+            printf("Choose allocation strategy:\n1. Marks (High->Low)\n2. A->Z\n3. Z->A\n4. SAP asc\n5. Random\n");
+            printf("6. Balanced marks (even batch averages)\n7. Student preferences (%d loaded)\n", pref_records);
+            printf("8. Toggle incremental maintenance (currently %s)\n", incremental_alloc ? "ON" : "OFF");
+            printf("9. Toggle per-course allocation (currently %s)\n", course_partitioned ? "ON" : "OFF");
+            printf("10. Random: shuffles to compare (currently %d) and seed\n", random_trials);
+            printf("11. Toggle proportional placement (currently %s)\n", proportional_placement ? "ON" : "OFF");
+            printf("12. Compare strategies 1-6 (changes nothing)\nSelect: ");
+            int s;
+            if (scanf("%d", &s) != 1) { clear_input(); continue; }
+            clear_input();
+            if (s >= 1 && s <= 7) {
+                if (run_strategy(&strategies[s - 1]) == 0) wal_checkpoint();
+            }
+            else if (s == 8) {
+                incremental_alloc = !incremental_alloc;
+                printf("Incremental maintenance %s.%s\n", incremental_alloc ? "ON" : "OFF",
+                       incremental_alloc && alloc_kind == ORDER_NONE ? " It takes effect after the next allocation." : "");
+            }
+            else if (s == 9) {
+                course_partitioned = !course_partitioned;
+                printf("Per-course allocation %s.\n", course_partitioned ? "ON" : "OFF");
+            }
+            else if (s == 10) set_random_interactive();
+            else if (s == 11) {
+                proportional_placement = !proportional_placement;
+                printf("Proportional placement %s: strategies 1-5 %s.\n", proportional_placement ? "ON" : "OFF",
+                       proportional_placement ? "fill batches in proportion to capacity" : "deal students out round-robin");
+            }
+            else if (s == 12) compare_strategies(stdout);
+            else printf("Invalid strategy.\n");
+        }
+        else if (ch == 8) {
+            char fname[128];
             printf("Enter filename to save (e.g. students_out.csv): ");
             if (!fgets(fname, sizeof fname, stdin)) continue;
             fname[strcspn(fname, "\n")] = '\0';
@@ -514,10 +4004,44 @@ static void admin_menu(void) {
             printf("Enter filename to load (e.g. students.csv): ");
             if (!fgets(fname, sizeof fname, stdin)) continue;
             fname[strcspn(fname, "\n")] = '\0';
-            load_csv(fname);
+            if (load_csv(fname) == 0) wal_checkpoint();
         }
         else if (ch == 10) print_summary();
-        else if (ch == 11) break;
+        else if (ch == 11 || ch == 12) {
+            char fname[128];
+            printf("Enter snapshot filename (press Enter for %s): ", SNAPSHOT_FILE);
+            if (!fgets(fname, sizeof fname, stdin)) continue;
+            fname[strcspn(fname, "\n")] = '\0';
+            if (strlen(fname) == 0) safe_strdup_truncate(fname, SNAPSHOT_FILE, sizeof fname);
+            /* srms.snap is the journal's base: saving over it is a checkpoint */
+            if (ch == 11 && journal_on && strcmp(fname, SNAPSHOT_FILE) == 0) wal_checkpoint();
+            else if (ch == 11) save_snapshot(fname);
+            else if (load_snapshot(fname) == 0) wal_checkpoint();
+        }
+        else if (ch == 13) delete_students_from_file();
+        else if (ch == 14) {
+            char fname[128];
+            printf("Enter preferences CSV (sap,choice1,choice2,...): ");
+            if (!fgets(fname, sizeof fname, stdin)) continue;
+            fname[strcspn(fname, "\n")] = '\0';
+            load_preferences(fname);
+        }
+        else if (ch == 15) {
+            char fname[128];
+            printf("Enter filename for the JSON stats (e.g. stats.json): ");
+            if (!fgets(fname, sizeof fname, stdin)) continue;
+            fname[strcspn(fname, "\n")] = '\0';
+            if (strlen(fname) > 0) write_phase_json(fname);
+        }
+        else if (ch == 16) {
+            char fname[128];
+            printf("Enter filename for the rosters (e.g. rosters.csv): ");
+            if (!fgets(fname, sizeof fname, stdin)) continue;
+            fname[strcspn(fname, "\n")] = '\0';
+            if (strlen(fname) > 0) save_rosters(fname);
+        }
+        else if (ch == 17) merge_interactive();
+        else if (ch == 18) break;
         else printf("Invalid choice.\n");
     }
 }
@@ -529,36 +4053,736 @@ static void print_summary(void) {
     printf("Total students: %d\n", student_count);
     printf("Total batches: %d\n", batch_count);
     int allocated = 0;
-    for (int i = 0; i < student_count; ++i) if (students[i].allocated_batch >= 0) allocated++;
+    for (int i = 0; i < student_slots; ++i) allocated += st_batch[i] >= 0;
     printf("Allocated students: %d\n", allocated);
     printf("Unallocated students: %d\n", student_count - allocated);
     printf("Total capacity: %d\n", total_capacity());
+    if (allocated > 0) report_batch_balance();
+    print_random_run();
+    print_phase_table();
     printf("======================\n");
 }
 
+/* Per-batch mean and standard deviation of marks, and the spread of the
+ * means across non-empty batches */
+static void report_batch_balance(void) {
+    double lo = 0, hi = 0, msum = 0, msq = 0;
+    int used = 0;
+    for (int b = 0; b < batch_count; ++b) {
+        const Batch *bt = &batches[b];
+        if (bt->filled == 0) { report("  %-20s   0 students\n", bt->name); continue; }
+        double s = 0, sq = 0;
+        for (int j = 0; j < bt->filled; ++j) {
+            double m = (double)st_marks[bt->members[j]] / MARKS_SCALE;
+            s += m; sq += m * m;
+        }
+        double mean = s / bt->filled, var = sq / bt->filled - mean * mean;
+        report("  %-20s %3d students  mean %6.2f  sd %6.2f\n", bt->name, bt->filled, mean, sqrt(var > 0 ? var : 0));
+        if (used == 0 || mean < lo) lo = mean;
+        if (used == 0 || mean > hi) hi = mean;
+        msum += mean; msq += mean * mean;
+        used++;
+    }
+    if (used == 0) return;
+    double mm = msum / used, mvar = msq / used - mm * mm;
+    report("  Batch means: range %.2f, sd %.2f\n", hi - lo, sqrt(mvar > 0 ? mvar : 0));
+}
+
+/* The last random allocation, with what it takes to replay it */
+static void print_random_run(void) {
+    const RandomRun *rr = &random_last;
+    if (!rr->valid) return;
+    printf("Last random allocation: seed %llu", (unsigned long long)rr->seed);
+    if (rr->trials > 1)
+        printf(", best of %d shuffles (trial %d, balance score %.3f; mean %.3f)", rr->trials, rr->best, rr->score,
+               rr->mean_score);
+    printf("\n  replay: --strategy random --seed %llu --trials %d%s\n", (unsigned long long)rr->seed, rr->trials,
+           rr->proportional ? " --placement proportional" : "");
+}
+
+/* Latest load, save, sort and allocate with their costs */
+static void print_phase_table(void) {
+    int any = 0;
+    for (int p = 0; p < PHASE_COUNT; ++p) any |= phase_stats[p].valid;
+    if (!any) return;
+    printf("Last operations:\n");
+    printf("  %-9s %10s %10s %12s %10s %11s\n", "phase", "seconds", "items", "comparisons", "allocs", "peak KiB");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        const PhaseStats *ps = &phase_stats[p];
+        if (!ps->valid) continue;
+        printf("  %-9s %10.4f %10llu %12llu %10llu %10ld%s  %s\n", phase_names[p], ps->seconds,
+               (unsigned long long)ps->items, (unsigned long long)ps->comparisons,
+               (unsigned long long)ps->allocs, ps->peak_kb, ps->peak_scoped ? " " : "*", ps->op);
+    }
+    if (phase_stats[PHASE_SORT].valid && course_partitioned)
+        printf("  (per-course sort time is summed over worker threads)\n");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        if (phase_stats[p].valid && !phase_stats[p].peak_scoped) {
+            printf("  * peak for the whole process so far\n");
+            break;
+        }
+    }
+}
+
 static int total_capacity(void) {
     int sum = 0;
     for (int i = 0; i < batch_count; ++i) sum += batches[i].capacity;
     return sum;
 }
 
+/* ---------------- Command-line Mode ---------------- */
+
+static void cli_usage(FILE *out) {
+    fprintf(out,
+        "Usage: srms                      (interactive menus)\n"
+        "       srms allocate (--in FILE | --snapshot-in FILE | --merge FILE) [--batches FILE]\n"
+        "                     [--merge FILE]... [--on-duplicate POLICY] [--merge-report FILE]\n"
+        "                     [--strategy NAME] [--prefs FILE] [--by-course] [--out FILE] [--snapshot-out FILE]\n"
+        "                     [--rosters FILE] [--stats FILE] [--seed N] [--trials K]\n"
+        "                     [--placement round-robin|proportional] [--compare FILE]\n"
+        "       srms bench --in FILE --batches FILE [--prefs FILE] [--label TEXT]\n"
+        "       srms serve (--in FILE | --snapshot-in FILE) [--batches FILE] [--prefs FILE]\n"
+        "                  [--strategy NAME] [--socket PATH] [--threads N] [--seed N] [--trials K]\n"
+        "                  [--placement round-robin|proportional]\n"
+        "\n"
+        "  --in FILE            student CSV to load\n"
+        "  --snapshot-in FILE   binary snapshot to load (students, batches and allocation)\n"
+        "  --merge FILE         student CSV to merge into the loaded students (repeatable, in order);\n"
+        "                       new SAPs are added unallocated, existing ones resolved by --on-duplicate\n"
+        "  --on-duplicate POLICY  keep (default) the record already loaded, overwrite it with the\n"
+        "                       merged row, or keep the newest by file modification time\n"
+        "  --merge-report FILE  write per-file merge counts and timings (- for stderr)\n"
+        "  --batches FILE       batch spec CSV (name,capacity[,course] per line); defaults to the\n"
+        "                       FILE.batches saved next to the --in CSV, if any\n"
+        "  --strategy NAME      marks | az | za | sap | random | balanced | prefs; omit to keep the loaded allocation\n"
+        "  --prefs FILE         ranked batch choices (sap,choice1,choice2,...) for --strategy prefs\n"
+        "  --by-course          run the strategy separately for each course, in parallel,\n"
+        "                       seating students only in batches tagged with their course\n"
+        "  --out FILE           where to write the allocated CSV\n"
+        "  --snapshot-out FILE  where to write a binary snapshot\n"
+        "  --rosters FILE       where to write each batch's members (batch,seat,sap,name,marks,course)\n"
+        "  --stats FILE         write per-phase timing and counters as JSON (- for stderr)\n"
+        "  --seed N             seed for --strategy random (default: fresh; the one used is\n"
+        "                       shown in the Summary Report and --stats output)\n"
+        "  --trials K           random: score K shuffles in parallel on marks balance and\n"
+        "                       course mix, and keep the best (default 1)\n"
+        "  --placement MODE     how marks, az, za, sap and random seat their order: round-robin\n"
+        "                       (default) or proportional, filling batches at the same rate\n"
+        "  --compare FILE       before --strategy runs, write how each strategy would fill the\n"
+        "                       batches (per-batch marks and course mix, and a summary; - for stdout)\n"
+        "  (with none of --out, --snapshot-out, --rosters or --compare the CSV goes to stdout)\n"
+        "\n"
+        "bench times loading, saving, every strategy, SAP lookups and deletions on the\n"
+        "given roster and prints one JSON object per operation.\n"
+        "\n"
+        "serve answers lookups on a Unix socket (default " SERVE_SOCKET ") until SIGINT or\n"
+        "SIGTERM, one request per line: GET sap, ROSTER batch, STATS, and the admin\n"
+        "requests ALLOCATE strategy [by-course] [proportional] and RELOAD, which publish new results\n"
+        "without pausing lookups.\n"
+        "\n"
+        "Exit status: 0 on success, 1 on usage errors, 2 if loading, allocation or saving fails.\n");
+}
+
+static void free_all(void) {
+    free_students();
+    sap_index_free();
+    nameidx_free(&name_index);
+    free_batches();
+    free_preferences();
+}
+
+/* --seed and --trials, either of which may be NULL. Returns 0, or -1
+ * after printing why a value is unusable. */
+static int set_random_options(const char *seed, const char *trials) {
+    if (seed) {
+        char *end;
+        errno = 0;
+        unsigned long long v = strtoull(seed, &end, 10);
+        if (errno != 0 || end == seed || *end || seed[0] == '-') {
+            fprintf(stderr, "srms: --seed needs a non-negative integer\n");
+            return -1;
+        }
+        random_next_seed = v;
+        random_seeded = 1;
+    }
+    if (trials) {
+        random_trials = atoi(trials);
+        if (random_trials < 1 || random_trials > RANDOM_TRIALS_MAX) {
+            fprintf(stderr, "srms: --trials needs a number from 1 to %d\n", RANDOM_TRIALS_MAX);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* --placement, which may be NULL. Returns 0, or -1 after printing why. */
+static int set_placement(const char *mode) {
+    if (!mode) return 0;
+    if (strcmp(mode, "round-robin") == 0) proportional_placement = 0;
+    else if (strcmp(mode, "proportional") == 0) proportional_placement = 1;
+    else {
+        fprintf(stderr, "srms: --placement needs round-robin or proportional\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* --on-duplicate, which may be NULL. Returns 0, or -1 after printing why. */
+static int set_merge_policy(const char *name, MergePolicy *policy) {
+    if (!name) return 0;
+    for (int i = 0; i < (int)(sizeof merge_policy_names / sizeof merge_policy_names[0]); ++i) {
+        if (strcmp(name, merge_policy_names[i]) == 0) { *policy = (MergePolicy)i; return 0; }
+    }
+    fprintf(stderr, "srms: --on-duplicate needs keep, overwrite or newest\n");
+    return -1;
+}
+
+/* Headless load -> allocate -> save. No prompts, no screen clearing. */
+static int run_cli(int argc, char **argv) {
+    headless = 1;
+    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "help") == 0) {
+        cli_usage(stdout);
+        return 0;
+    }
+    if (strcmp(argv[1], "bench") == 0) return run_bench(argc, argv);
+    if (strcmp(argv[1], "serve") == 0) return run_serve(argc, argv);
+    if (strcmp(argv[1], "allocate") != 0) {
+        fprintf(stderr, "srms: unknown command '%s'\n", argv[1]);
+        cli_usage(stderr);
+        return 1;
+    }
+
+    const char *in = NULL, *spec = NULL, *strategy = NULL, *out = NULL;
+    const char *snap_in = NULL, *snap_out = NULL, *prefs = NULL, *stats = NULL, *rosters = NULL;
+    const char *seed = NULL, *trials = NULL, *placement = NULL, *on_dup = NULL, *merge_report = NULL;
+    const char *compare = NULL;
+    const char *merges[MERGE_FILES_MAX];
+    int nmerge = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char **dst = NULL;
+        if (strcmp(argv[i], "--by-course") == 0) { course_partitioned = 1; continue; }
+        if (strcmp(argv[i], "--merge") == 0) {
+            if (i + 1 >= argc) { fprintf(stderr, "srms: %s needs a value\n", argv[i]); return 1; }
+            if (nmerge == MERGE_FILES_MAX) { fprintf(stderr, "srms: at most %d --merge files\n", MERGE_FILES_MAX); return 1; }
+            merges[nmerge++] = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--in") == 0) dst = &in;
+        else if (strcmp(argv[i], "--on-duplicate") == 0) dst = &on_dup;
+        else if (strcmp(argv[i], "--merge-report") == 0) dst = &merge_report;
+        else if (strcmp(argv[i], "--snapshot-in") == 0) dst = &snap_in;
+        else if (strcmp(argv[i], "--snapshot-out") == 0) dst = &snap_out;
+        else if (strcmp(argv[i], "--batches") == 0) dst = &spec;
+        else if (strcmp(argv[i], "--strategy") == 0) dst = &strategy;
+        else if (strcmp(argv[i], "--out") == 0) dst = &out;
+        else if (strcmp(argv[i], "--prefs") == 0) dst = &prefs;
+        else if (strcmp(argv[i], "--stats") == 0) dst = &stats;
+        else if (strcmp(argv[i], "--rosters") == 0) dst = &rosters;
+        else if (strcmp(argv[i], "--seed") == 0) dst = &seed;
+        else if (strcmp(argv[i], "--trials") == 0) dst = &trials;
+        else if (strcmp(argv[i], "--placement") == 0) dst = &placement;
+        else if (strcmp(argv[i], "--compare") == 0) dst = &compare;
+        else { fprintf(stderr, "srms: unknown option '%s'\n", argv[i]); cli_usage(stderr); return 1; }
+        if (i + 1 >= argc) { fprintf(stderr, "srms: %s needs a value\n", argv[i]); return 1; }
+        *dst = argv[++i];
+    }
+    if ((in && snap_in) || (!in && !snap_in && nmerge == 0)) { cli_usage(stderr); return 1; }
+    MergePolicy policy = MERGE_KEEP;
+    if (set_random_options(seed, trials) != 0 || set_placement(placement) != 0 ||
+        set_merge_policy(on_dup, &policy) != 0) return 1;
+
+    const StrategyEntry *chosen = NULL;
+    for (size_t i = 0; strategy && i < sizeof strategies / sizeof strategies[0]; ++i) {
+        if (strcmp(strategies[i].name, strategy) == 0) chosen = &strategies[i];
+    }
+    if (strategy && !chosen) { fprintf(stderr, "srms: unknown strategy '%s'\n", strategy); return 1; }
+    if (!out && !snap_out && !rosters && !compare) out = "/dev/stdout";
+
+    int rc = 0;
+    MergeFileReport rep[MERGE_FILES_MAX] = { 0 };
+    int merged = 0;   /* merge_csv ran and filled rep */
+    if ((in || snap_in) && (in ? load_csv(in) : load_snapshot(snap_in)) != 0) rc = 2;
+    if (rc == 0 && nmerge > 0) {
+        merged = 1;
+        if (merge_csv(merges, nmerge, policy, rep) != 0) rc = 2;
+    }
+    if (rc != 0) { /* nothing more to do */ }
+    else if (spec && load_batch_spec(spec) != 0) rc = 2;
+    else if (prefs && load_preferences(prefs) != 0) rc = 2;
+    else if (compare && save_comparison(compare) != 0) rc = 2;
+    else if (chosen && run_strategy(chosen) != 0) rc = 2;
+    else if (out && save_csv(out) != 0) rc = 2;
+    else if (snap_out && save_snapshot(snap_out) != 0) rc = 2;
+    else if (rosters && save_rosters(rosters) != 0) rc = 2;
+    if (merge_report && merged) {
+        FILE *f = strcmp(merge_report, "-") == 0 ? stderr : fopen(merge_report, "w");
+        if (!f) { report_error("Could not open %s for writing.\n", merge_report); if (rc == 0) rc = 2; }
+        else {
+            write_merge_report(f, rep, nmerge, policy);
+            if (f != stderr && fclose(f) != 0 && rc == 0) rc = 2;
+        }
+    }
+    if (stats && write_phase_json(stats) != 0 && rc == 0) rc = 2;
+    free_all();
+    return rc;
+}
+
+/* ---------------- Benchmark Mode ---------------- */
+
+
+/* One JSON line per operation, so runs can be appended and diffed across
+ * versions */
+static void bench_emit(const char *label, const char *op, long items, double secs) {
+    printf("{\"label\":\"");
+    for (const char *c = label; *c; ++c) {
+        if (*c == '"' || *c == '\\') putchar('\\');
+        if ((unsigned char)*c >= 0x20) putchar(*c);
+    }
+    printf("\",\"op\":\"%s\",\"students\":%d,\"batches\":%d,\"items\":%ld,\"seconds\":%.6f,\"per_sec\":%.0f}\n",
+           op, student_count, batch_count, items, secs, secs > 0 ? items / secs : 0.0);
+    fflush(stdout);
+}
+
+/* Load, allocate with every strategy, save, look up and delete, timing
+ * each step on the roster given. Scratch output goes next to the input. */
+static int run_bench(int argc, char **argv) {
+    const char *in = NULL, *spec = NULL, *prefs = NULL, *label = "";
+    for (int i = 2; i < argc; ++i) {
+        const char **dst = NULL;
+        if (strcmp(argv[i], "--in") == 0) dst = &in;
+        else if (strcmp(argv[i], "--batches") == 0) dst = &spec;
+        else if (strcmp(argv[i], "--prefs") == 0) dst = &prefs;
+        else if (strcmp(argv[i], "--label") == 0) dst = &label;
+        else { fprintf(stderr, "srms: unknown option '%s'\n", argv[i]); cli_usage(stderr); return 1; }
+        if (i + 1 >= argc) { fprintf(stderr, "srms: %s needs a value\n", argv[i]); return 1; }
+        *dst = argv[++i];
+    }
+    if (!in || !spec) { cli_usage(stderr); return 1; }
+    random_next_seed = 1;
+    random_seeded = 1;
+
+    char scratch[512];
+    snprintf(scratch, sizeof scratch, "%s.bench-out", in);
+    int rc = 2;
+    int *victims = NULL;
+    double t = stats_now();
+    if (load_csv(in) != 0) goto done;
+    bench_emit(label, "load_csv", student_count, stats_now() - t);
+    if (load_batch_spec(spec) != 0 || (prefs && load_preferences(prefs) != 0)) goto done;
+
+    for (size_t i = 0; i < sizeof strategies / sizeof strategies[0]; ++i) {
+        if (strategies[i].run == allocation_by_preference && !prefs) continue;
+        char op[64];
+        for (course_partitioned = 0; course_partitioned <= 1; ++course_partitioned) {
+            snprintf(op, sizeof op, "allocate:%s%s", strategies[i].name, course_partitioned ? "/by-course" : "");
+            t = stats_now();
+            if (strategies[i].run() != 0) goto done;
+            bench_emit(label, op, student_count, stats_now() - t);
+        }
+    }
+    course_partitioned = 0;
+
+    /* Monte Carlo random: one shuffle per thread, then four per thread */
+    for (int per = 1; per <= 4; per *= 4) {
+        char op[64];
+        random_trials = per * pool_default_threads();
+        snprintf(op, sizeof op, "allocate:random/best-of-%d", random_trials);
+        t = stats_now();
+        if (allocation_random() != 0) goto done;
+        bench_emit(label, op, student_count, stats_now() - t);
+    }
+    random_trials = 1;
+
+    proportional_placement = 1;
+    t = stats_now();
+    if (allocation_by_marks() != 0) goto done;
+    bench_emit(label, "allocate:marks/proportional", student_count, stats_now() - t);
+    proportional_placement = 0;
+    if (allocation_by_marks() != 0) goto done;
+
+    t = stats_now();
+    if (save_comparison(scratch) != 0) goto done;
+    bench_emit(label, "compare", student_count, stats_now() - t);
+
+    t = stats_now();
+    if (save_csv(scratch) != 0) goto done;
+    bench_emit(label, "save_csv", student_count, stats_now() - t);
+    t = stats_now();
+    if (save_rosters(scratch) != 0) goto done;
+    bench_emit(label, "save_rosters", student_count, stats_now() - t);
+    t = stats_now();
+    if (save_snapshot(scratch) != 0) goto done;
+    bench_emit(label, "save_snapshot", student_count, stats_now() - t);
+    t = stats_now();
+    if (load_snapshot(scratch) != 0) goto done;
+    bench_emit(label, "load_snapshot", student_count, stats_now() - t);
+
+    /* every student once, in random order */
+    int n = student_count;
+    victims = stats_malloc(sizeof(int) * (n ? n : 1));
+    if (!victims) goto done;
+    for (int i = 0, k = 0; i < student_slots; ++i) if (student_alive(i)) victims[k++] = i;
+    Rng r;
+    rng_seed(&r, 1, 0);
+    shuffle_slots(&r, victims, n);
+    long found = 0;
+    t = stats_now();
+    for (int i = 0; i < n; ++i) found += find_student_by_sap(student_sap(victims[i])) >= 0;
+    bench_emit(label, "find_student_by_sap", n, stats_now() - t);
+    if (found != n) { fprintf(stderr, "srms: bench lookup missed %ld students\n", n - found); goto done; }
+
+    /* name searches: the first three letters of a name, then the whole
+     * name with one letter changed */
+    t = stats_now();
+    if (name_index_rebuild() != 0) goto done;
+    bench_emit(label, "name_index_build", n, stats_now() - t);
+    int nq = n < 10000 ? n : 10000, hits[NAME_MATCHES_MAX];
+    char q[NAME_LEN];
+    found = 0;
+    t = stats_now();
+    for (int i = 0; i < nq; ++i) {
+        snprintf(q, 4, "%s", student_name(victims[i]));
+        found += nameidx_prefix(&name_index, q, hits, NAME_MATCHES_MAX) > 0;
+    }
+    bench_emit(label, "name_prefix", nq, stats_now() - t);
+    nq = n < 1000 ? n : 1000;
+    NameHit near[NAME_MATCHES_MAX];
+    t = stats_now();
+    for (int i = 0; i < nq; ++i) {
+        snprintf(q, sizeof q, "%s", student_name(victims[i]));
+        q[strlen(q) / 2] = q[strlen(q) / 2] == 'x' ? 'y' : 'x';
+        found += nameidx_fuzzy(&name_index, q, 1, near, NAME_MATCHES_MAX) > 0;
+    }
+    bench_emit(label, "name_fuzzy", nq, stats_now() - t);
+    if (found != (n < 10000 ? n : 10000) + nq) { fprintf(stderr, "srms: bench name search missed students\n"); goto done; }
+
+    /* withdraw a tenth of the roster, by SAP as delete_student does */
+    int del = n / 10;
+    t = stats_now();
+    for (int i = 0; i < del; ++i) remove_student(find_student_by_sap(student_sap(victims[i])));
+    bench_emit(label, "delete_student", del, stats_now() - t);
+    rc = 0;
+done:
+    stats_free(victims);
+    remove(scratch);
+    char side[1024];
+    batch_sidecar_name(side, sizeof side, scratch);
+    remove(side);
+    free_all();
+    return rc;
+}
+
+/* ---------------- Server Mode ---------------- */
+
+/* What lookups read: a frozen copy of the results with every reply
+ * preformatted, so requests never touch the live student arrays that
+ * admin requests modify. Offsets point into text. */
+typedef struct {
+    uint32_t hash;
+    uint32_t sap;         /* NUL-terminated SAP; UINT32_MAX = empty slot */
+    uint32_t reply, reply_len;
+} ViewSlot;
+
+typedef struct {
+    ServeOut text;
+    ViewSlot *slots;      /* open addressing on the SAP hash */
+    uint32_t mask;
+    int nbatches;
+    uint32_t *batch_name, *roster, *roster_len;
+    int students, allocated;
+    uint64_t version;
+} LookupView;
+
+/* The startup inputs, which RELOAD reads again */
+typedef struct {
+    const char *in, *snap_in, *spec, *prefs;
+    const StrategyEntry *strategy;
+} ServeSource;
+
+static pthread_mutex_t serve_admin_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t serve_version = 0;
+
+static void view_free(LookupView *v) {
+    if (!v) return;
+    stats_free(v->text.buf);
+    stats_free(v->slots);
+    stats_free(v->batch_name);
+    stats_free(v->roster);
+    stats_free(v->roster_len);
+    stats_free(v);
+}
+
+/* A reply field: tabs and line breaks would split the reply, so they become spaces */
+static void view_field(ServeOut *o, const char *s) {
+    for (const char *p = s; *p; ) {
+        size_t n = strcspn(p, "\t\r\n");
+        serve_out(o, p, n);
+        p += n;
+        if (*p) { serve_out(o, " ", 1); p++; }
+    }
+}
+
+static void view_int(ServeOut *o, long long v) {
+    char tmp[24];
+    serve_out(o, tmp, (size_t)snprintf(tmp, sizeof tmp, "%lld", v));
+}
+
+static void view_marks(ServeOut *o, int hundredths) {
+    char tmp[16];
+    serve_out_str(o, format_marks(hundredths, tmp));
+}
+
+/* Snapshot the current students and batches. Returns NULL on memory error. */
+static LookupView *view_build(void) {
+    LookupView *v = stats_calloc(1, sizeof *v);
+    if (!v) return NULL;
+    uint32_t cap = 64;
+    while (cap < (uint32_t)student_count * 2) cap *= 2;
+    v->slots = stats_malloc(sizeof(ViewSlot) * cap);
+    v->nbatches = batch_count;
+    size_t nb = batch_count ? (size_t)batch_count : 1;
+    v->batch_name = stats_malloc(sizeof(uint32_t) * nb);
+    v->roster = stats_malloc(sizeof(uint32_t) * nb);
+    v->roster_len = stats_malloc(sizeof(uint32_t) * nb);
+    if (!v->slots || !v->batch_name || !v->roster || !v->roster_len) { view_free(v); return NULL; }
+    v->mask = cap - 1;
+    for (uint32_t i = 0; i < cap; ++i) v->slots[i].sap = UINT32_MAX;
+
+    ServeOut *t = &v->text;
+    for (int i = 0; i < student_slots; ++i) {
+        if (!student_alive(i)) continue;
+        const char *sap = student_sap(i);
+        uint32_t h = sap_hash(sap), pos = h & v->mask;
+        while (v->slots[pos].sap != UINT32_MAX) pos = (pos + 1) & v->mask;
+        ViewSlot *vs = &v->slots[pos];
+        vs->hash = h;
+        vs->sap = (uint32_t)t->len;
+        serve_out(t, sap, strlen(sap) + 1);
+        vs->reply = (uint32_t)t->len;
+        serve_out_str(t, "OK ");
+        view_field(t, sap);
+        serve_out(t, "\t", 1);
+        view_field(t, student_name(i));
+        serve_out(t, "\t", 1);
+        view_marks(t, st_marks[i]);
+        serve_out(t, "\t", 1);
+        view_field(t, st_course[i] >= 0 ? student_course(i) : "-");
+        serve_out(t, "\t", 1);
+        view_field(t, st_batch[i] >= 0 ? batches[st_batch[i]].name : "-");
+        serve_out(t, "\n", 1);
+        vs->reply_len = (uint32_t)(t->len - vs->reply);
+        v->allocated += st_batch[i] >= 0;
+    }
+    for (int b = 0; b < batch_count; ++b) {
+        const Batch *bt = &batches[b];
+        v->batch_name[b] = (uint32_t)t->len;
+        serve_out(t, bt->name, strlen(bt->name) + 1);
+        v->roster[b] = (uint32_t)t->len;
+        serve_out_str(t, "OK ");
+        view_int(t, bt->filled);
+        serve_out(t, "\n", 1);
+        for (int j = 0; j < bt->filled; ++j) {
+            int i = bt->members[j];
+            view_field(t, student_sap(i));
+            serve_out(t, "\t", 1);
+            view_field(t, student_name(i));
+            serve_out(t, "\t", 1);
+            view_marks(t, st_marks[i]);
+            serve_out(t, "\n", 1);
+        }
+        v->roster_len[b] = (uint32_t)(t->len - v->roster[b]);
+    }
+    if (t->error || t->len > UINT32_MAX) { view_free(v); return NULL; }
+    v->students = student_count;
+    v->version = ++serve_version;
+    return v;
+}
+
+/* Rebuild the view from the live data and swap it in. Caller holds serve_admin_lock. */
+static int view_republish(void) {
+    LookupView *v = view_build();
+    if (!v) return -1;
+    view_free(serve_publish(v));
+    return 0;
+}
+
+static void serve_admin(const char *cmd, const char *arg, ServeOut *out, const ServeSource *src) {
+    pthread_mutex_lock(&serve_admin_lock);
+    int rc;
+    if (strcmp(cmd, "RELOAD") == 0) {
+        rc = src->in ? load_csv(src->in) : load_snapshot(src->snap_in);
+        if (rc == 0 && src->spec) rc = load_batch_spec(src->spec);
+        if (rc == 0 && src->prefs) rc = load_preferences(src->prefs);
+        if (rc == 0 && src->strategy) rc = run_strategy(src->strategy);
+        if (rc != 0) serve_out_str(out, "ERR reload failed\n");
+    } else {
+        char name[32];
+        size_t n = strcspn(arg, " ");
+        snprintf(name, sizeof name, "%.*s", (int)(n < sizeof name ? n : sizeof name - 1), arg);
+        const StrategyEntry *se = NULL;
+        for (size_t i = 0; i < sizeof strategies / sizeof strategies[0]; ++i) {
+            if (strcmp(strategies[i].name, name) == 0) se = &strategies[i];
+        }
+        /* the options apply to this run only; RELOAD keeps the startup ones */
+        int by_course = course_partitioned, proportional = proportional_placement;
+        course_partitioned = strstr(arg + n, "by-course") != NULL;
+        proportional_placement = strstr(arg + n, "proportional") != NULL;
+        rc = se ? run_strategy(se) : -1;
+        course_partitioned = by_course;
+        proportional_placement = proportional;
+        if (!se) serve_out_str(out, "ERR unknown strategy\n");
+        else if (rc != 0) serve_out_str(out, "ERR allocation failed\n");
+    }
+    if (rc == 0) {
+        if (view_republish() != 0) serve_out_str(out, "ERR out of memory\n");
+        else {
+            char line[96];
+            int allocated = 0;
+            for (int i = 0; i < student_slots; ++i) allocated += st_batch[i] >= 0;
+            snprintf(line, sizeof line, "OK version=%llu students=%d allocated=%d\n",
+                     (unsigned long long)serve_version, student_count, allocated);
+            serve_out_str(out, line);
+        }
+    }
+    pthread_mutex_unlock(&serve_admin_lock);
+}
+
+/* One request line: COMMAND [argument] */
+static void serve_request(const void *view, const char *line, size_t len, ServeOut *out, void *ctx) {
+    const LookupView *v = view;
+    size_t cl = 0;
+    while (cl < len && line[cl] != ' ') cl++;
+    const char *arg = line + cl;
+    size_t alen = len - cl;
+    while (alen > 0 && *arg == ' ') { arg++; alen--; }
+    while (alen > 0 && arg[alen - 1] == ' ') alen--;
+
+    if (cl == 3 && memcmp(line, "GET", 3) == 0) {
+        char sap[SAP_LEN];
+        if (alen > 0 && alen < sizeof sap) {
+            memcpy(sap, arg, alen);
+            sap[alen] = '\0';
+            uint32_t h = sap_hash(sap);
+            for (uint32_t pos = h & v->mask; v->slots[pos].sap != UINT32_MAX; pos = (pos + 1) & v->mask) {
+                const ViewSlot *vs = &v->slots[pos];
+                if (vs->hash == h && strcmp(v->text.buf + vs->sap, sap) == 0) {
+                    serve_out(out, v->text.buf + vs->reply, vs->reply_len);
+                    return;
+                }
+            }
+        }
+        serve_out_str(out, "NOTFOUND\n");
+    } else if (cl == 6 && memcmp(line, "ROSTER", 6) == 0) {
+        for (int b = 0; b < v->nbatches; ++b) {
+            const char *name = v->text.buf + v->batch_name[b];
+            if (strlen(name) == alen && memcmp(name, arg, alen) == 0) {
+                serve_out(out, v->text.buf + v->roster[b], v->roster_len[b]);
+                return;
+            }
+        }
+        serve_out_str(out, "NOTFOUND\n");
+    } else if (cl == 5 && memcmp(line, "STATS", 5) == 0) {
+        char reply[128];
+        snprintf(reply, sizeof reply, "OK version=%llu students=%d allocated=%d batches=%d\n",
+                 (unsigned long long)v->version, v->students, v->allocated, v->nbatches);
+        serve_out_str(out, reply);
+    } else if ((cl == 8 && memcmp(line, "ALLOCATE", 8) == 0) || (cl == 6 && memcmp(line, "RELOAD", 6) == 0)) {
+        char cmd[16], a[64];
+        snprintf(cmd, sizeof cmd, "%.*s", (int)cl, line);
+        snprintf(a, sizeof a, "%.*s", (int)(alen < sizeof a ? alen : sizeof a - 1), arg);
+        /* v may be freed from here on; another admin request holding the
+         * lock publishes without waiting for this one */
+        serve_release();
+        serve_admin(cmd, a, out, ctx);
+    } else if (len > 0) {
+        serve_out_str(out, "ERR unknown request\n");
+    }
+}
+
+/* Load once, then answer lookups until told to stop */
+static int run_serve(int argc, char **argv) {
+    ServeSource src = { NULL, NULL, NULL, NULL, NULL };
+    const char *sock = SERVE_SOCKET, *threads_arg = NULL, *strategy = NULL, *seed = NULL, *trials = NULL;
+    const char *placement = NULL;
+    for (int i = 2; i < argc; ++i) {
+        const char **dst = NULL;
+        if (strcmp(argv[i], "--in") == 0) dst = &src.in;
+        else if (strcmp(argv[i], "--snapshot-in") == 0) dst = &src.snap_in;
+        else if (strcmp(argv[i], "--batches") == 0) dst = &src.spec;
+        else if (strcmp(argv[i], "--prefs") == 0) dst = &src.prefs;
+        else if (strcmp(argv[i], "--socket") == 0) dst = &sock;
+        else if (strcmp(argv[i], "--threads") == 0) dst = &threads_arg;
+        else if (strcmp(argv[i], "--strategy") == 0) dst = &strategy;
+        else if (strcmp(argv[i], "--seed") == 0) dst = &seed;
+        else if (strcmp(argv[i], "--trials") == 0) dst = &trials;
+        else if (strcmp(argv[i], "--placement") == 0) dst = &placement;
+        else { fprintf(stderr, "srms: unknown option '%s'\n", argv[i]); cli_usage(stderr); return 1; }
+        if (i + 1 >= argc) { fprintf(stderr, "srms: %s needs a value\n", argv[i]); return 1; }
+        *dst = argv[++i];
+    }
+    if (!src.in == !src.snap_in) { cli_usage(stderr); return 1; }
+    if (set_random_options(seed, trials) != 0 || set_placement(placement) != 0) return 1;
+    int threads = threads_arg ? atoi(threads_arg) : pool_default_threads();
+    if (threads < 1) { fprintf(stderr, "srms: --threads needs a positive number\n"); return 1; }
+    const StrategyEntry *chosen = NULL;
+    for (size_t i = 0; strategy && i < sizeof strategies / sizeof strategies[0]; ++i) {
+        if (strcmp(strategies[i].name, strategy) == 0) chosen = &strategies[i];
+    }
+    if (strategy && !chosen) { fprintf(stderr, "srms: unknown strategy '%s'\n", strategy); return 1; }
+    src.strategy = chosen;
+
+    int rc = 0;
+    if ((src.in ? load_csv(src.in) : load_snapshot(src.snap_in)) != 0) rc = 2;
+    else if (src.spec && load_batch_spec(src.spec) != 0) rc = 2;
+    else if (src.prefs && load_preferences(src.prefs) != 0) rc = 2;
+    else if (src.strategy && run_strategy(src.strategy) != 0) rc = 2;
+    else if (view_republish() != 0) { fprintf(stderr, "srms: out of memory\n"); rc = 2; }
+    else {
+        fprintf(stderr, "srms: serving %d students on %s with %d threads\n", student_count, sock, threads);
+        if (serve_run(sock, threads, serve_request, &src) != 0) {
+            fprintf(stderr, "srms: cannot listen on %s: %s\n", sock, strerror(errno));
+            rc = 2;
+        }
+    }
+    view_free(serve_publish(NULL));
+    free_all();
+    return rc;
+}
+
 /* ---------------- Main ---------------- */
 
-int main(void) {
-    srand((unsigned int)time(NULL));
+int main(int argc, char **argv) {
+    if (argc > 1) return run_cli(argc, argv);
 
     /* Use intro.c / outro.c screens */
     showIntro();
 
-    /* Auto-load students.csv at startup if present */
-    if (file_exists("students.csv")) {
+    /* Auto-load at startup: a snapshot restores the allocation too, so it
+     * wins unless students.csv was changed after both it and its journal
+     * (a hand edit; the journal then no longer applies and is set aside) */
+    int have_snap = file_exists(SNAPSHOT_FILE), have_csv = file_exists("students.csv"), csv_won = 0;
+    long long snap_time = file_mtime(SNAPSHOT_FILE), csv_time = file_mtime("students.csv");
+    if (file_mtime(JOURNAL_FILE) > snap_time) snap_time = file_mtime(JOURNAL_FILE);
+    if (have_snap && have_csv && csv_time > snap_time) {
+        printf("students.csv was changed after %s; loading students.csv instead of the snapshot...\n", SNAPSHOT_FILE);
+        csv_won = load_csv("students.csv") == 0;
+    }
+    else if (have_snap) {
+        if (have_csv) printf("Loading %s (newer than students.csv)...\n", SNAPSHOT_FILE);
+        else printf("Detected %s in working directory. Loading...\n", SNAPSHOT_FILE);
+        if (load_snapshot(SNAPSHOT_FILE) != 0 && have_csv) load_csv("students.csv");
+    }
+    else if (have_csv) {
         printf("Detected students.csv in working directory. Loading...\n");
         load_csv("students.csv");
     }
+    wal_start();
+    /* replace the outdated snapshot, as loading a CSV from the menu does */
+    if (csv_won) wal_checkpoint();
 
     for (;;) {
         printf("\n=== Main Menu ===\n");
-        printf("1. Student Access (search by SAP)\n2. Admin Access\n3. Exit\n");
+        printf("1. Student Access (search by SAP or name)\n2. Admin Access\n3. Exit\n");
         printf("Choose option: ");
         int ch;
         if (scanf("%d", &ch) != 1) { clear_input(); continue; }
@@ -570,11 +4794,8 @@ int main(void) {
     }
 
     /* Cleanup */
-    if (students) free(students);
-    for (int i = 0; i < batch_count; ++i) {
-        if (batches[i].members) free(batches[i].members);
-    }
-    if (batches) free(batches);
+    wal_stop();
+    free_all();
 
     showThankYou();
     return 0;
@@ -0,0 +1,217 @@
+#include "mcflow.h"
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+#define MCF_INF INT64_MAX
+
+int mcf_init(McfGraph *g, int nodes, int arcs_hint) {
+    memset(g, 0, sizeof *g);
+    g->nodes = nodes;
+    g->head = stats_malloc(sizeof(int) * (nodes ? nodes : 1));
+    g->pot = stats_calloc((size_t)(nodes ? nodes : 1), sizeof(int64_t));
+    if (!g->head || !g->pot) { mcf_free(g); return -1; }
+    for (int i = 0; i < nodes; ++i) g->head[i] = -1;
+    if (arcs_hint > 0) {
+        g->next = stats_malloc(sizeof(int) * (size_t)arcs_hint * 2);
+        g->to = stats_malloc(sizeof(int) * (size_t)arcs_hint * 2);
+        g->cap = stats_malloc(sizeof(int) * (size_t)arcs_hint * 2);
+        g->cost = stats_malloc(sizeof(int) * (size_t)arcs_hint * 2);
+        if (!g->next || !g->to || !g->cap || !g->cost) { mcf_free(g); return -1; }
+        g->arc_cap = arcs_hint * 2;
+    }
+    return 0;
+}
+
+static int grow_arcs(McfGraph *g) {
+    int ncap = g->arc_cap ? g->arc_cap * 2 : 1024;
+    int **cols[] = { &g->next, &g->to, &g->cap, &g->cost };
+    for (size_t c = 0; c < sizeof cols / sizeof cols[0]; ++c) {
+        int *tmp = stats_realloc(*cols[c], sizeof(int) * (size_t)ncap);
+        if (!tmp) return -1;
+        *cols[c] = tmp;
+    }
+    g->arc_cap = ncap;
+    return 0;
+}
+
+int mcf_add_arc(McfGraph *g, int from, int to, int cap, int cost) {
+    if (g->arcs + 2 > g->arc_cap && grow_arcs(g) != 0) return -1;
+    int a = g->arcs;
+    g->to[a] = to;     g->cap[a] = cap; g->cost[a] = cost;  g->next[a] = g->head[from];     g->head[from] = a;
+    g->to[a + 1] = from; g->cap[a + 1] = 0; g->cost[a + 1] = -cost; g->next[a + 1] = g->head[to]; g->head[to] = a + 1;
+    g->arcs += 2;
+    return a;
+}
+
+/* The solver works on a CSR copy of the residual graph (each node's arcs
+ * contiguous, twins cross-linked through rev[]); the linked adjacency is
+ * too scattered for the repeated whole-graph searches. */
+typedef struct {
+    int nodes;
+    int *start;   /* nodes + 1 */
+    int *to, *cap, *cost, *rev;
+    const int64_t *pot;
+} Csr;
+
+static int64_t reduced(const Csr *c, int u, int i) {
+    return c->cost[i] + c->pot[u] - c->pot[c->to[i]];
+}
+
+/* ---- Dijkstra on reduced costs (binary heap with lazy deletion) ---- */
+
+typedef struct { int64_t d; int v; } HeapItem;
+
+static void heap_push(HeapItem *h, int *n, HeapItem it) {
+    int i = (*n)++;
+    while (i > 0 && h[(i - 1) / 2].d > it.d) { h[i] = h[(i - 1) / 2]; i = (i - 1) / 2; }
+    h[i] = it;
+}
+
+static HeapItem heap_pop(HeapItem *h, int *n) {
+    HeapItem top = h[0], last = h[--(*n)];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= *n) break;
+        if (c + 1 < *n && h[c + 1].d < h[c].d) c++;
+        if (h[c].d >= last.d) break;
+        h[i] = h[c]; i = c;
+    }
+    if (*n > 0) h[i] = last;
+    return top;
+}
+
+/* Shortest reduced distances from s; then shift potentials so that every
+ * residual arc keeps a non-negative reduced cost and shortest-path arcs
+ * drop to zero. Returns 1 if t is reachable, 0 if not. */
+static int update_potentials(const Csr *c, int64_t *pot, int s, int t, int64_t *dist, HeapItem *heap) {
+    for (int v = 0; v < c->nodes; ++v) dist[v] = MCF_INF;
+    int hn = 0;
+    dist[s] = 0;
+    heap_push(heap, &hn, (HeapItem){ 0, s });
+    int64_t maxd = 0;
+    while (hn > 0) {
+        HeapItem it = heap_pop(heap, &hn);
+        if (it.d != dist[it.v]) continue;
+        int u = it.v;
+        maxd = it.d;
+        for (int i = c->start[u]; i < c->start[u + 1]; ++i) {
+            if (c->cap[i] <= 0) continue;
+            int v = c->to[i];
+            int64_t nd = it.d + reduced(c, u, i);
+            if (nd < dist[v]) { dist[v] = nd; heap_push(heap, &hn, (HeapItem){ nd, v }); }
+        }
+    }
+    if (dist[t] == MCF_INF) return 0;
+    /* unreached nodes move by the largest distance, which keeps arcs from
+     * them into reached nodes non-negative */
+    for (int v = 0; v < c->nodes; ++v) pot[v] += dist[v] == MCF_INF ? maxd : dist[v];
+    return 1;
+}
+
+/* ---- Dinic on the zero-reduced-cost residual subgraph ---- */
+
+static int admissible(const Csr *c, int u, int i) {
+    return c->cap[i] > 0 && reduced(c, u, i) == 0;
+}
+
+static int bfs_levels(const Csr *c, int s, int t, int *level, int *queue) {
+    for (int v = 0; v < c->nodes; ++v) level[v] = -1;
+    int qh = 0, qt = 0;
+    level[s] = 0;
+    queue[qt++] = s;
+    while (qh < qt) {
+        int u = queue[qh++];
+        /* nothing at or beyond t's level can lie on a shortest path */
+        if (level[t] >= 0 && level[u] >= level[t]) break;
+        for (int i = c->start[u]; i < c->start[u + 1]; ++i) {
+            int v = c->to[i];
+            if (level[v] < 0 && admissible(c, u, i)) { level[v] = level[u] + 1; queue[qt++] = v; }
+        }
+    }
+    return level[t] >= 0;
+}
+
+/* One augmenting path in the level graph, walked iteratively with an
+ * explicit stack of arcs; cur[] keeps each node's next arc to try. */
+static int augment(Csr *c, int s, int t, const int *level, int *cur, int *stack) {
+    int depth = 0, u = s;
+    for (;;) {
+        if (u == t) {
+            int f = c->cap[stack[0]];
+            for (int k = 1; k < depth; ++k) if (c->cap[stack[k]] < f) f = c->cap[stack[k]];
+            for (int k = 0; k < depth; ++k) { c->cap[stack[k]] -= f; c->cap[c->rev[stack[k]]] += f; }
+            return f;
+        }
+        int i = cur[u], end = c->start[u + 1];
+        while (i < end && !(level[c->to[i]] == level[u] + 1 && admissible(c, u, i))) i++;
+        cur[u] = i;
+        if (i < end) {
+            stack[depth++] = i;
+            u = c->to[i];
+            continue;
+        }
+        /* dead end: retreat and skip the arc that led here */
+        if (depth == 0) return 0;
+        i = stack[--depth];
+        u = c->to[c->rev[i]];
+        cur[u]++;
+    }
+}
+
+int mcf_solve(McfGraph *g, int s, int t, int64_t *flow, int64_t *cost) {
+    int n = g->nodes, m = g->arcs;
+    Csr c = { n, NULL, NULL, NULL, NULL, NULL, g->pot };
+    c.start = stats_calloc((size_t)n + 1, sizeof(int));
+    c.to = stats_malloc(sizeof(int) * (m ? m : 1));
+    c.cap = stats_malloc(sizeof(int) * (m ? m : 1));
+    c.cost = stats_malloc(sizeof(int) * (m ? m : 1));
+    c.rev = stats_malloc(sizeof(int) * (m ? m : 1));
+    int *pos = stats_malloc(sizeof(int) * (m ? m : 1));
+    int64_t *dist = stats_malloc(sizeof(int64_t) * n);
+    HeapItem *heap = stats_malloc(sizeof(HeapItem) * ((size_t)m + 1));
+    int *level = stats_malloc(sizeof(int) * n);
+    int *queue = stats_malloc(sizeof(int) * n);
+    int *cur = stats_malloc(sizeof(int) * n);
+    int *stack = stats_malloc(sizeof(int) * n);
+    int rc = -1;
+    if (!c.start || !c.to || !c.cap || !c.cost || !c.rev || !pos || !dist || !heap ||
+        !level || !queue || !cur || !stack) goto done;
+
+    /* tail of arc a is the head of its twin */
+    for (int a = 0; a < m; ++a) c.start[g->to[a ^ 1] + 1]++;
+    for (int v = 0; v < n; ++v) c.start[v + 1] += c.start[v];
+    memcpy(cur, c.start, sizeof(int) * n);
+    for (int a = 0; a < m; ++a) pos[a] = cur[g->to[a ^ 1]]++;
+    for (int a = 0; a < m; ++a) {
+        int i = pos[a];
+        c.to[i] = g->to[a]; c.cap[i] = g->cap[a]; c.cost[i] = g->cost[a]; c.rev[i] = pos[a ^ 1];
+    }
+
+    int64_t f = 0;
+    while (update_potentials(&c, g->pot, s, t, dist, heap) == 1) {
+        while (bfs_levels(&c, s, t, level, queue)) {
+            memcpy(cur, c.start, sizeof(int) * n);
+            int d;
+            while ((d = augment(&c, s, t, level, cur, stack)) > 0) f += d;
+        }
+    }
+    int64_t total = 0;
+    for (int a = 0; a < m; ++a) {
+        g->cap[a] = c.cap[pos[a]];
+        if (!(a & 1)) total += (int64_t)g->cost[a] * c.cap[pos[a ^ 1]];
+    }
+    if (flow) *flow = f;
+    if (cost) *cost = total;
+    rc = 0;
+done:
+    stats_free(c.start); stats_free(c.to); stats_free(c.cap); stats_free(c.cost); stats_free(c.rev); stats_free(pos);
+    stats_free(dist); stats_free(heap); stats_free(level); stats_free(queue); stats_free(cur); stats_free(stack);
+    return rc;
+}
+
+void mcf_free(McfGraph *g) {
+    stats_free(g->head); stats_free(g->next); stats_free(g->to); stats_free(g->cap); stats_free(g->cost); stats_free(g->pot);
+    memset(g, 0, sizeof *g);
+}
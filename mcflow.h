@@ -0,0 +1,40 @@
+#ifndef MCFLOW_H
+#define MCFLOW_H
+
+#include <stdint.h>
+
+/* Min-cost max-flow on a directed graph with non-negative integer arc
+ * costs. Arcs are stored in pairs (arc a and its residual twin a ^ 1), with
+ * adjacency as singly linked lists through next[]. */
+typedef struct {
+    int nodes;
+    int arcs, arc_cap;
+    int *head;       /* per node: first arc, or -1 */
+    int *next;       /* per arc */
+    int *to;
+    int *cap;        /* residual capacity */
+    int *cost;
+    int64_t *pot;    /* node potentials, valid after mcf_solve */
+} McfGraph;
+
+/* Set up an empty graph with the given node count. Returns 0, or -1 on
+ * memory error. arcs_hint pre-sizes the arc arrays (0 is fine). */
+int mcf_init(McfGraph *g, int nodes, int arcs_hint);
+
+/* Add an arc from -> to with capacity cap and cost >= 0. Returns the arc
+ * id, or -1 on memory error. */
+int mcf_add_arc(McfGraph *g, int from, int to, int cap, int cost);
+
+/* Units that went through arc a (as added by mcf_add_arc) */
+static inline int mcf_flow(const McfGraph *g, int a) { return g->cap[a ^ 1]; }
+
+/* Push the maximum flow from s to t at minimum total cost. Primal-dual:
+ * each phase runs Dijkstra on reduced costs, then saturates the
+ * zero-reduced-cost subgraph with Dinic blocking flows, so the number of
+ * phases is the number of distinct augmenting path costs (small when costs
+ * are small integers). Returns 0, or -1 on memory error. */
+int mcf_solve(McfGraph *g, int s, int t, int64_t *flow, int64_t *cost);
+
+void mcf_free(McfGraph *g);
+
+#endif /* MCFLOW_H */
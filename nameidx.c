@@ -0,0 +1,281 @@
+#include "nameidx.h"
+#include <stdlib.h>
+#include <string.h>
+#include "order.h"
+#include "stats.h"
+
+#define QUERY_MAX 128
+
+static void fold_into(char *dst, size_t n, const char *s) {
+    size_t i = 0;
+    for (; s[i] && i + 1 < n; ++i) {
+        unsigned char c = (unsigned char)s[i];
+        dst[i] = (char)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    dst[i] = '\0';
+}
+
+static const char *key_str(const NameIndex *ix, const NameKey *k) {
+    return ix->folded.buf + k->name + k->start;
+}
+
+/* Order of a key against (s, slot) */
+static int key_cmp(const NameIndex *ix, const NameKey *k, const char *s, int slot) {
+    int c = strcmp(key_str(ix, k), s);
+    if (c != 0) return c;
+    return (k->slot > slot) - (k->slot < slot);
+}
+
+/* First key not ordered before (s, slot) */
+static int key_lower_bound(const NameIndex *ix, const char *s, int slot) {
+    int lo = 0, hi = ix->n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (key_cmp(ix, &ix->keys[mid], s, slot) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int is_word_start(const char *name, int i) {
+    return i == 0 || (name[i - 1] == ' ' && name[i] != ' ');
+}
+
+static int reserve_keys(NameIndex *ix, int n) {
+    if (n <= ix->cap) return 0;
+    int want = ix->cap ? ix->cap : 256;
+    while (want < n) want *= 2;
+    NameKey *tmp = stats_realloc(ix->keys, sizeof(NameKey) * (size_t)want);
+    if (!tmp) return -1;
+    ix->keys = tmp;
+    ix->cap = want;
+    return 0;
+}
+
+static int reserve_slots(NameIndex *ix, int n) {
+    if (n <= ix->slot_cap) return 0;
+    int want = ix->slot_cap ? ix->slot_cap : 256;
+    while (want < n) want *= 2;
+    uint32_t *tmp = stats_realloc(ix->slot_name, sizeof(uint32_t) * (size_t)want);
+    if (!tmp) return -1;
+    for (int i = ix->slot_cap; i < want; ++i) tmp[i] = STRPOOL_NONE;
+    ix->slot_name = tmp;
+    ix->slot_cap = want;
+    return 0;
+}
+
+/* Fold and store slot's name; returns its offset or STRPOOL_NONE */
+static uint32_t store_name(NameIndex *ix, int slot, const char *name) {
+    if (reserve_slots(ix, slot + 1) != 0) return STRPOOL_NONE;
+    size_t len = strlen(name);
+    if (len > UINT16_MAX) len = UINT16_MAX;
+    char *tmp = stats_malloc(len + 1);
+    if (!tmp) return STRPOOL_NONE;
+    fold_into(tmp, len + 1, name);
+    uint32_t off = strpool_intern(&ix->folded, tmp, len);
+    stats_free(tmp);
+    if (off == STRPOOL_NONE) return off;
+    ix->slot_name[slot] = off;
+    if ((int)len > ix->max_len) ix->max_len = (int)len;
+    return off;
+}
+
+static const char *built_key_str(int idx, void *ctx) {
+    const NameIndex *ix = ctx;
+    return key_str(ix, &ix->keys[idx]);
+}
+
+int nameidx_build(NameIndex *ix, const int *slots, int n, NameOfFn name_of, void *ctx) {
+    nameidx_clear(ix);
+    for (int i = 0; i < n; ++i) {
+        uint32_t off = store_name(ix, slots[i], name_of(slots[i], ctx));
+        if (off == STRPOOL_NONE) goto oom;
+        const char *name = ix->folded.buf + off;
+        for (int p = 0; name[p]; ++p) {
+            if (!is_word_start(name, p)) continue;
+            if (reserve_keys(ix, ix->n + 1) != 0) goto oom;
+            ix->keys[ix->n++] = (NameKey){ off, (uint16_t)p, 0, slots[i] };
+        }
+    }
+    /* the keys were made in slot order, which is the tiebreak order_sort keeps */
+    OrderKey *order = stats_malloc(sizeof(OrderKey) * (size_t)(ix->n ? ix->n : 1));
+    NameKey *sorted = stats_malloc(sizeof(NameKey) * (size_t)(ix->n ? ix->n : 1));
+    if (!order || !sorted) { stats_free(order); stats_free(sorted); goto oom; }
+    for (int k = 0; k < ix->n; ++k) {
+        order[k].key = order_fold_prefix(key_str(ix, &ix->keys[k]));
+        order[k].idx = k;
+    }
+    if (order_sort(order, ix->n, 0, built_key_str, ix, NULL) != 0) { stats_free(order); stats_free(sorted); goto oom; }
+    for (int k = 0; k < ix->n; ++k) sorted[k] = ix->keys[order[k].idx];
+    stats_free(order);
+    stats_free(ix->keys);
+    ix->keys = sorted;
+    ix->cap = ix->n ? ix->n : 1;
+    ix->built = 1;
+    return 0;
+oom:
+    nameidx_clear(ix);
+    return -1;
+}
+
+int nameidx_add(NameIndex *ix, int slot, const char *name) {
+    uint32_t off = store_name(ix, slot, name);
+    if (off == STRPOOL_NONE) return -1;
+    const char *folded = ix->folded.buf + off;
+    for (int p = 0; folded[p]; ++p) {
+        if (!is_word_start(folded, p)) continue;
+        if (reserve_keys(ix, ix->n + 1) != 0) return -1;
+        folded = ix->folded.buf + off;
+        int at = key_lower_bound(ix, folded + p, slot);
+        memmove(&ix->keys[at + 1], &ix->keys[at], sizeof(NameKey) * (size_t)(ix->n - at));
+        ix->keys[at] = (NameKey){ off, (uint16_t)p, 0, slot };
+        ix->n++;
+    }
+    return 0;
+}
+
+void nameidx_remove(NameIndex *ix, int slot) {
+    if (slot < 0 || slot >= ix->slot_cap || ix->slot_name[slot] == STRPOOL_NONE) return;
+    const char *name = ix->folded.buf + ix->slot_name[slot];
+    for (int p = 0; name[p]; ++p) {
+        if (!is_word_start(name, p)) continue;
+        /* a dead copy from an earlier life of the slot may come first */
+        for (int at = key_lower_bound(ix, name + p, slot); at < ix->n; ++at) {
+            NameKey *k = &ix->keys[at];
+            if (k->slot != slot || strcmp(key_str(ix, k), name + p) != 0) break;
+            if (!k->dead) { k->dead = 1; ix->dead++; break; }
+        }
+    }
+    ix->slot_name[slot] = STRPOOL_NONE;
+    if (ix->dead * 2 > ix->n) {
+        int o = 0;
+        for (int i = 0; i < ix->n; ++i) if (!ix->keys[i].dead) ix->keys[o++] = ix->keys[i];
+        ix->n = o;
+        ix->dead = 0;
+    }
+}
+
+int nameidx_prefix(const NameIndex *ix, const char *prefix, int *out, int max) {
+    char q[QUERY_MAX];
+    fold_into(q, sizeof q, prefix);
+    size_t qlen = strlen(q);
+    int count = 0;
+    /* slot -1 sorts before every real slot of an equal key */
+    for (int i = key_lower_bound(ix, q, -1); i < ix->n && count < max; ++i) {
+        const NameKey *k = &ix->keys[i];
+        if (strncmp(key_str(ix, k), q, qlen) != 0) break;
+        if (k->dead) continue;
+        /* count a student once: only through the first word that matches */
+        const char *name = ix->folded.buf + k->name;
+        int earlier = 0;
+        for (int p = 0; p < k->start && !earlier; ++p) {
+            earlier = is_word_start(name, p) && strncmp(name + p, q, qlen) == 0;
+        }
+        if (earlier) continue;
+        out[count++] = k->slot;
+    }
+    return count;
+}
+
+/* First key after i that does not start with the d bytes of key i */
+static int skip_prefix(const NameIndex *ix, int i, int d) {
+    const char *s = key_str(ix, &ix->keys[i]);
+    int lo = i + 1, hi = ix->n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strncmp(key_str(ix, &ix->keys[mid]), s, (size_t)d) == 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Keep the best distance per student, at most max students, nearest first */
+static void add_hit(NameHit *out, int *n, int max, int slot, int dist) {
+    /* a student already kept is kept at a distance no worse than this */
+    if (*n == max && (max == 0 || out[max - 1].dist <= dist)) return;
+    for (int j = 0; j < *n; ++j) {
+        if (out[j].slot != slot) continue;
+        if (dist >= out[j].dist) return;
+        out[j].dist = dist;
+        for (; j > 0 && out[j - 1].dist > out[j].dist; --j) {
+            NameHit t = out[j]; out[j] = out[j - 1]; out[j - 1] = t;
+        }
+        return;
+    }
+    int j = *n < max ? (*n)++ : max - 1;
+    out[j] = (NameHit){ slot, dist };
+    for (; j > 0 && out[j - 1].dist > out[j].dist; --j) {
+        NameHit t = out[j]; out[j] = out[j - 1]; out[j - 1] = t;
+    }
+}
+
+int nameidx_fuzzy(const NameIndex *ix, const char *query, int maxdist, NameHit *out, int max) {
+    char q[QUERY_MAX];
+    fold_into(q, sizeof q, query);
+    int m = (int)strlen(q), w = m + 1;
+    /* row d holds the distances between the first d bytes of the current
+     * key and every prefix of the query; near[d] is the least distance
+     * between the whole query and any of those first d bytes */
+    int *rows = stats_malloc(sizeof(int) * ((size_t)(ix->max_len + 1) * (size_t)w + (size_t)ix->max_len + 1));
+    if (!rows) return -1;
+    int *near = rows + (size_t)(ix->max_len + 1) * (size_t)w;
+    for (int j = 0; j <= m; ++j) rows[j] = j;
+    near[0] = m;
+
+    /* once out is full, only keys closer than its worst can get in */
+    int found = 0, depth = 0, limit = maxdist;
+    const char *prev = "";
+    for (int i = 0; i < ix->n && limit >= 0; ) {
+        const char *key = key_str(ix, &ix->keys[i]);
+        int l = 0;
+        while (l < depth && key[l] == prev[l]) l++;
+        depth = l;
+        prev = key;
+        int pruned = 0;
+        while (key[depth]) {
+            const int *up = rows + (size_t)depth * w;
+            int *r = rows + (size_t)(depth + 1) * w;
+            unsigned char c = (unsigned char)key[depth];
+            int best = r[0] = depth + 1;
+            for (int j = 1; j <= m; ++j) {
+                int v = up[j - 1] + ((unsigned char)q[j - 1] != c);
+                if (up[j] + 1 < v) v = up[j] + 1;
+                if (r[j - 1] + 1 < v) v = r[j - 1] + 1;
+                r[j] = v;
+                if (v < best) best = v;
+            }
+            near[depth + 1] = r[m] < near[depth] ? r[m] : near[depth];
+            depth++;
+            if (best > limit) { pruned = 1; break; }
+        }
+        if (pruned) {
+            /* no longer start of these keys comes closer than near[depth] */
+            int next = skip_prefix(ix, i, depth);
+            for (; near[depth] <= limit && i < next; ++i)
+                if (!ix->keys[i].dead) add_hit(out, &found, max, ix->keys[i].slot, near[depth]);
+            i = next;
+        } else {
+            if (near[depth] <= limit && !ix->keys[i].dead) add_hit(out, &found, max, ix->keys[i].slot, near[depth]);
+            i++;
+        }
+        if (found == max) limit = max > 0 ? out[max - 1].dist - 1 : -1;
+    }
+    stats_free(rows);
+    return found;
+}
+
+void nameidx_clear(NameIndex *ix) {
+    ix->n = 0;
+    ix->dead = 0;
+    ix->max_len = 0;
+    for (int i = 0; i < ix->slot_cap; ++i) ix->slot_name[i] = STRPOOL_NONE;
+    strpool_clear(&ix->folded);
+    ix->built = 0;
+}
+
+void nameidx_free(NameIndex *ix) {
+    stats_free(ix->keys);
+    stats_free(ix->slot_name);
+    strpool_free(&ix->folded);
+    memset(ix, 0, sizeof *ix);
+}
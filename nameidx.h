@@ -0,0 +1,65 @@
+#ifndef NAMEIDX_H
+#define NAMEIDX_H
+
+#include <stdint.h>
+#include "strpool.h"
+
+/* Case-insensitive name search. Every word of a name starts one key: the
+ * folded name from that word to the end ("asha rao" gives "asha rao" and
+ * "rao"), so a query can match a first name, a surname or the full name.
+ * Keys live in one sorted array; prefix queries are a binary search plus a
+ * scan, and edit-distance queries walk the array like a trie, reusing the
+ * DP rows of the prefix shared with the previous key and skipping every
+ * key under a prefix that is already too far from the query. */
+typedef struct {
+    uint32_t name;    /* folded name in the index's pool */
+    uint16_t start;   /* key = name + start: 0 or just after a space */
+    uint16_t dead;    /* removed; dropped at the next compaction */
+    int slot;
+} NameKey;
+
+typedef struct {
+    NameKey *keys;        /* sorted by key, then slot */
+    int n, cap;
+    int dead;             /* keys marked dead */
+    uint32_t *slot_name;  /* per slot: its folded name, or STRPOOL_NONE */
+    int slot_cap;
+    int max_len;          /* longest folded name, for the DP rows */
+    StrPool folded;
+    int built;
+} NameIndex;
+
+typedef struct {
+    int slot;
+    int dist;
+} NameHit;
+
+typedef const char *(*NameOfFn)(int slot, void *ctx);
+
+/* Index the n given slots from scratch. Returns 0, or -1 on memory error
+ * (the index is left empty and unbuilt). */
+int nameidx_build(NameIndex *ix, const int *slots, int n, NameOfFn name_of, void *ctx);
+
+/* Keep a built index current. An add is a binary search plus a move of the
+ * keys after the insertion point; a remove marks its keys dead, and they
+ * are squeezed out once half the keys are dead, so it is amortised
+ * O(log n). nameidx_add returns 0, or -1 on memory error. */
+int nameidx_add(NameIndex *ix, int slot, const char *name);
+void nameidx_remove(NameIndex *ix, int slot);
+
+/* Students with a word starting with prefix (case-insensitive), in key
+ * order. Writes up to max slots to out and returns how many were written;
+ * the scan stops there, so the cost is O(log n + max). */
+int nameidx_prefix(const NameIndex *ix, const char *prefix, int *out, int max);
+
+/* Students with a name word whose start is within maxdist edits
+ * (Levenshtein) of query, so a misspelt first name, surname or partial
+ * name still finds them. Writes up to max of the closest to out, nearest
+ * first, and returns how many were written, or -1 on memory error. */
+int nameidx_fuzzy(const NameIndex *ix, const char *query, int maxdist, NameHit *out, int max);
+
+/* Forget everything; the next nameidx_build starts over */
+void nameidx_clear(NameIndex *ix);
+void nameidx_free(NameIndex *ix);
+
+#endif /* NAMEIDX_H */
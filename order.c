@@ -0,0 +1,115 @@
+#include "order.h"
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+uint64_t order_fold_prefix(const char *s) {
+    uint64_t k = 0;
+    int i = 0;
+    for (; i < 8 && s[i]; ++i) k = (k << 8) | fold((unsigned char)s[i]);
+    return k << (8 * (8 - i));
+}
+
+int order_fold_cmp(const char *a, const char *b) {
+    const unsigned char *pa = (const unsigned char *)a, *pb = (const unsigned char *)b;
+    for (;; ++pa, ++pb) {
+        unsigned char ca = fold(*pa), cb = fold(*pb);
+        if (ca != cb || ca == 0) return (int)ca - (int)cb;
+    }
+}
+
+/* Stable LSD radix sort on the 64-bit key, one byte per pass. Passes where
+ * every key shares the same byte are skipped, so small key ranges (marks)
+ * cost a single pass. */
+static void radix_sort(OrderKey *keys, OrderKey *tmp, int n) {
+    OrderKey *src = keys, *dst = tmp;
+    for (int shift = 0; shift < 64; shift += 8) {
+        int count[256] = {0};
+        for (int i = 0; i < n; ++i) count[(src[i].key >> shift) & 0xff]++;
+        if (count[(src[0].key >> shift) & 0xff] == n) continue;
+        int pos = 0;
+        for (int b = 0; b < 256; ++b) { int c = count[b]; count[b] = pos; pos += c; }
+        for (int i = 0; i < n; ++i) dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+        OrderKey *t = src; src = dst; dst = t;
+    }
+    if (src != keys) memcpy(keys, src, sizeof(OrderKey) * n);
+}
+
+/* Stable merge sort of an equal-prefix run by full string */
+static void refine_run(OrderKey *run, OrderKey *tmp, int n, int sign, OrderStrFn str_of, void *ctx, uint64_t *cmps) {
+    if (n <= 16) {
+        for (int i = 1; i < n; ++i) {
+            OrderKey k = run[i];
+            const char *ks = str_of(k.idx, ctx);
+            int j = i - 1;
+            for (; j >= 0; --j) {
+                ++*cmps;
+                if (sign * order_fold_cmp(str_of(run[j].idx, ctx), ks) <= 0) break;
+                run[j + 1] = run[j];
+            }
+            run[j + 1] = k;
+        }
+        return;
+    }
+    int half = n / 2;
+    refine_run(run, tmp, half, sign, str_of, ctx, cmps);
+    refine_run(run + half, tmp, n - half, sign, str_of, ctx, cmps);
+    memcpy(tmp, run, sizeof(OrderKey) * half);
+    int i = 0, j = half, o = 0;
+    while (i < half && j < n) {
+        ++*cmps;
+        if (sign * order_fold_cmp(str_of(run[j].idx, ctx), str_of(tmp[i].idx, ctx)) < 0) run[o++] = run[j++];
+        else run[o++] = tmp[i++];
+    }
+    while (i < half) run[o++] = tmp[i++];
+}
+
+int order_sort(OrderKey *keys, int n, int descending, OrderStrFn str_of, void *ctx, uint64_t *comparisons) {
+    if (n <= 1) return 0;
+    OrderKey *tmp = stats_malloc(sizeof(OrderKey) * n);
+    if (!tmp) return -1;
+
+    if (descending) for (int i = 0; i < n; ++i) keys[i].key = ~keys[i].key;
+    radix_sort(keys, tmp, n);
+    if (descending) for (int i = 0; i < n; ++i) keys[i].key = ~keys[i].key;
+
+    uint64_t cmps = 0;
+    if (str_of) {
+        int sign = descending ? -1 : 1;
+        for (int start = 0; start < n;) {
+            int end = start + 1;
+            while (end < n && keys[end].key == keys[start].key) ++end;
+            /* a prefix with a zero low byte means both strings ended inside it */
+            if (end - start > 1 && (keys[start].key & 0xff) != 0)
+                refine_run(keys + start, tmp, end - start, sign, str_of, ctx, &cmps);
+            start = end;
+        }
+    }
+    stats_free(tmp);
+    if (comparisons) *comparisons += cmps;
+    return 0;
+}
+
+int order_counting_sort(const int *items, int n, const int *key_of, int range, int descending, int *out) {
+    int *start = stats_calloc((size_t)(range > 0 ? range : 1), sizeof(int));
+    int *tmp = out == items ? stats_malloc(sizeof(int) * (size_t)(n ? n : 1)) : out;
+    if (!start || !tmp) { stats_free(start); if (tmp != out) stats_free(tmp); return -1; }
+    for (int i = 0; i < n; ++i) {
+        int k = key_of[items[i]];
+        if (k < 0 || k >= range) { stats_free(start); if (tmp != out) stats_free(tmp); return 1; }
+        start[descending ? range - 1 - k : k]++;
+    }
+    int pos = 0;
+    for (int b = 0; b < range; ++b) { int c = start[b]; start[b] = pos; pos += c; }
+    for (int i = 0; i < n; ++i) {
+        int k = key_of[items[i]];
+        tmp[start[descending ? range - 1 - k : k]++] = items[i];
+    }
+    if (tmp != out) { memcpy(out, tmp, sizeof(int) * (size_t)n); stats_free(tmp); }
+    stats_free(start);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <stdint.h>
+
+/* One entry of a sort permutation: a compact primary key plus the index of
+ * the record it stands for. The index is also the final tiebreak, so the
+ * resulting order is deterministic. */
+typedef struct {
+    uint64_t key;
+    int idx;
+} OrderKey;
+
+/* Returns the full string for a record index; used only to break ties
+ * between keys whose 8-byte prefixes are equal. */
+typedef const char *(*OrderStrFn)(int idx, void *ctx);
+
+/* Pack the first 8 case-folded bytes of s big-endian, so comparing the
+ * resulting integers matches a case-insensitive string comparison. */
+uint64_t order_fold_prefix(const char *s);
+
+/* Case-insensitive comparison (ASCII folding, same as strcasecmp) */
+int order_fold_cmp(const char *a, const char *b);
+
+/* Sort keys[0..n) by key (ascending, or descending when descending != 0),
+ * ties broken by idx ascending. When str_of is non-NULL the keys are
+ * treated as folded string prefixes and equal-prefix runs are refined with
+ * a full order_fold_cmp. If comparisons is non-NULL the number of string
+ * comparisons made is added to it (the radix passes make none).
+ * Returns 0, or -1 on memory error. */
+int order_sort(OrderKey *keys, int n, int descending, OrderStrFn str_of, void *ctx, uint64_t *comparisons);
+
+/* Stable counting sort of n items by small integer keys: item x has key
+ * key_of[x], which must lie in [0, range). out (which may alias items)
+ * receives the items by key, ascending or descending, ties in their input
+ * order. Two passes over the items plus one over the range, no
+ * comparisons. Returns 0, 1 if a key is out of range (out is untouched),
+ * or -1 on memory error. */
+int order_counting_sort(const int *items, int n, const int *key_of, int range, int descending, int *out);
+
+#endif /* ORDER_H */
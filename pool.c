@@ -0,0 +1,49 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pool.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define POOL_MAX_THREADS 64
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next, ntasks;
+    PoolTaskFn task;
+    void *ctx;
+} PoolJob;
+
+static void *pool_worker(void *arg) {
+    PoolJob *job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int t = job->next < job->ntasks ? job->next++ : -1;
+        pthread_mutex_unlock(&job->lock);
+        if (t < 0) return NULL;
+        job->task(t, job->ctx);
+    }
+}
+
+int pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) return 1;
+    return n > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)n;
+}
+
+void pool_run(int ntasks, int nthreads, PoolTaskFn task, void *ctx) {
+    if (nthreads > ntasks) nthreads = ntasks;
+    if (nthreads > POOL_MAX_THREADS) nthreads = POOL_MAX_THREADS;
+    if (nthreads <= 1) {
+        for (int t = 0; t < ntasks; ++t) task(t, ctx);
+        return;
+    }
+
+    PoolJob job = { .next = 0, .ntasks = ntasks, .task = task, .ctx = ctx };
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_t tids[POOL_MAX_THREADS];
+    int started = 0;
+    while (started < nthreads - 1 && pthread_create(&tids[started], NULL, pool_worker, &job) == 0) started++;
+    pool_worker(&job);
+    for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    pthread_mutex_destroy(&job.lock);
+}
@@ -0,0 +1,17 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Minimal fork-join worker pool: run task(0..ntasks-1) across threads and
+ * wait for all of them. Tasks are handed out one at a time, so uneven task
+ * sizes balance themselves. */
+typedef void (*PoolTaskFn)(int task, void *ctx);
+
+/* Online CPU count, at least 1 */
+int pool_default_threads(void);
+
+/* Run every task on up to nthreads threads (the caller is one of them).
+ * Falls back to fewer threads, down to the caller alone, if threads
+ * cannot be started, so every task always runs exactly once. */
+void pool_run(int ntasks, int nthreads, PoolTaskFn task, void *ctx);
+
+#endif /* POOL_H */
@@ -0,0 +1,27 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "rng.h"
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng *r, uint64_t seed, uint64_t stream) {
+    /* hash the stream number first so neighbouring streams start far apart */
+    uint64_t sx = stream;
+    uint64_t x = seed ^ splitmix64(&sx);
+    for (int i = 0; i < 4; ++i) r->s[i] = splitmix64(&x);
+}
+
+uint64_t rng_fresh_seed(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t x = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    x ^= (uint64_t)getpid() << 32;
+    return splitmix64(&x);
+}
@@ -0,0 +1,43 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* xoshiro256** (Blackman & Vigna): a few cycles per number, a 2^256 - 1
+ * period and no shared state, so every thread can own a generator. The
+ * same seed always gives the same sequence, which makes random
+ * allocations replayable. */
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+/* Seed with splitmix64. Different streams of one seed give unrelated
+ * sequences, e.g. one per Monte Carlo trial. */
+void rng_seed(Rng *r, uint64_t seed, uint64_t stream);
+
+/* A seed from the clock and process id, for runs that were not given one */
+uint64_t rng_fresh_seed(void);
+
+static inline uint64_t rng_rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+static inline uint64_t rng_next(Rng *r) {
+    uint64_t *s = r->s;
+    uint64_t out = rng_rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return out;
+}
+
+/* Uniform in [0, n) for n > 0, without modulo bias (Lemire's
+ * multiply-shift; the rejection loop almost never runs) */
+static inline uint32_t rng_below(Rng *r, uint32_t n) {
+    uint64_t m = (rng_next(r) >> 32) * n;
+    if ((uint32_t)m < n) {
+        uint32_t floor = (uint32_t)-n % n;
+        while ((uint32_t)m < floor) m = (rng_next(r) >> 32) * n;
+    }
+    return (uint32_t)(m >> 32);
+}
+
+#endif /* RNG_H */
@@ -0,0 +1,230 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "serve.h"
+#include "pool.h"
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "stats.h"
+
+#define SERVE_MAX_WORKERS 64
+#define SERVE_IN_SIZE (16 * 1024)   /* longest request line, per connection */
+
+/* Grace periods: a worker announces the epoch it started a request in
+ * before it loads the view pointer, and clears it when done. A publisher
+ * bumps the epoch after the swap, so any worker still showing an older
+ * epoch may hold the old view and is waited for. */
+typedef struct {
+    _Alignas(64) atomic_uint_least64_t epoch;   /* 0 = not in a request */
+} ReaderSlot;
+
+static _Atomic(void *) serve_view;
+static atomic_uint_least64_t serve_epoch = 1;
+static ReaderSlot serve_readers[SERVE_MAX_WORKERS];
+static _Thread_local int serve_self = -1;
+
+static volatile sig_atomic_t serve_stop;
+static int serve_listen_fd = -1;
+
+typedef struct {
+    ServeHandlerFn fn;
+    void *ctx;
+} ServeJob;
+
+void serve_out(ServeOut *o, const char *s, size_t n) {
+    if (o->error) return;
+    if (o->cap - o->len < n) {
+        size_t want = o->cap ? o->cap : 4096;
+        while (want - o->len < n) want *= 2;
+        char *tmp = stats_realloc(o->buf, want);
+        if (!tmp) { o->error = 1; return; }
+        o->buf = tmp;
+        o->cap = want;
+    }
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+}
+
+void serve_out_str(ServeOut *o, const char *s) {
+    serve_out(o, s, strlen(s));
+}
+
+void *serve_publish(void *view) {
+    void *old = atomic_exchange(&serve_view, view);
+    uint_least64_t e = atomic_fetch_add(&serve_epoch, 1) + 1;
+    for (int w = 0; w < SERVE_MAX_WORKERS; ++w) {
+        if (w == serve_self) continue;
+        for (;;) {
+            uint_least64_t r = atomic_load(&serve_readers[w].epoch);
+            if (r == 0 || r >= e) break;
+            sched_yield();
+        }
+    }
+    return old;
+}
+
+void serve_release(void) {
+    if (serve_self >= 0) atomic_store(&serve_readers[serve_self].epoch, 0);
+}
+
+static void serve_on_signal(int sig) {
+    (void)sig;
+    serve_stop = 1;
+    if (serve_listen_fd >= 0) shutdown(serve_listen_fd, SHUT_RDWR);
+}
+
+static int send_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, 0);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+typedef struct {
+    int fd;
+    size_t have;
+    char *in;             /* SERVE_IN_SIZE bytes: the unanswered tail of the input */
+} ServeConn;
+
+/* Read what one readable connection has sent and answer every complete
+ * request line in it. Returns -1 when the connection should be closed. */
+static int serve_readable(ServeConn *c, const ServeJob *job, ServeOut *out) {
+    ReaderSlot *me = &serve_readers[serve_self];
+    ssize_t r = recv(c->fd, c->in + c->have, SERVE_IN_SIZE - c->have, 0);
+    if (r == 0) return -1;
+    if (r < 0) return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    c->have += (size_t)r;
+    size_t start = 0;
+    out->len = 0;
+    for (;;) {
+        char *nl = memchr(c->in + start, '\n', c->have - start);
+        if (!nl) break;
+        size_t len = (size_t)(nl - (c->in + start));
+        if (len > 0 && c->in[start + len - 1] == '\r') len--;
+        atomic_store(&me->epoch, atomic_load(&serve_epoch));
+        job->fn(atomic_load(&serve_view), c->in + start, len, out, job->ctx);
+        atomic_store(&me->epoch, 0);
+        start = (size_t)(nl - c->in) + 1;
+    }
+    if (start == 0 && c->have == SERVE_IN_SIZE) {
+        serve_out_str(out, "ERR line too long\n");
+        c->have = 0;
+    } else {
+        memmove(c->in, c->in + start, c->have - start);
+        c->have -= start;
+    }
+    return out->error || send_all(c->fd, out->buf, out->len) != 0 ? -1 : 0;
+}
+
+/* One worker: polls the listening socket and its own connections, so a
+ * few workers can serve any number of clients. New connections go to
+ * whichever worker accepts first. */
+static void serve_worker(int w, void *arg) {
+    const ServeJob *job = arg;
+    serve_self = w;
+    ServeConn *conns = NULL;
+    struct pollfd *pfds = NULL;
+    int n = 0, cap = 0;
+    ServeOut out = { 0 };
+    while (!serve_stop) {
+        if (n + 1 > cap) {
+            int want = cap ? cap * 2 : 16;
+            ServeConn *nc = stats_realloc(conns, sizeof(ServeConn) * (size_t)want);
+            if (nc) conns = nc;
+            struct pollfd *np = stats_realloc(pfds, sizeof(struct pollfd) * (size_t)(want + 1));
+            if (np) pfds = np;
+            if (!nc || !np) break;
+            cap = want;
+        }
+        pfds[0].fd = serve_listen_fd;
+        pfds[0].events = POLLIN;
+        for (int i = 0; i < n; ++i) { pfds[i + 1].fd = conns[i].fd; pfds[i + 1].events = POLLIN; }
+        /* time out now and then to notice a shutdown */
+        int ready = poll(pfds, (nfds_t)n + 1, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) break;   /* shut down */
+        for (int i = n - 1; i >= 0; --i) {
+            if (!pfds[i + 1].revents) continue;
+            if (serve_readable(&conns[i], job, &out) != 0) {
+                close(conns[i].fd);
+                stats_free(conns[i].in);
+                conns[i] = conns[--n];
+            }
+        }
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(serve_listen_fd, NULL, NULL);   /* another worker may have won */
+            if (fd < 0) {
+                if (errno == EMFILE || errno == ENFILE) sched_yield();
+                continue;
+            }
+            char *in = stats_malloc(SERVE_IN_SIZE);
+            if (!in) { close(fd); continue; }
+            conns[n++] = (ServeConn){ fd, 0, in };
+        }
+    }
+    for (int i = 0; i < n; ++i) { close(conns[i].fd); stats_free(conns[i].in); }
+    stats_free(conns);
+    stats_free(pfds);
+    stats_free(out.buf);
+}
+
+int serve_run(const char *path, int nthreads, ServeHandlerFn fn, void *ctx) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) { errno = ENAMETOOLONG; return -1; }
+    strcpy(addr.sun_path, path);
+
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    /* non-blocking, so workers that lose the race for a connection move on */
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+    sa.sa_handler = serve_on_signal;   /* no SA_RESTART: blocked calls return EINTR */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    serve_stop = 0;
+    serve_listen_fd = fd;
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > SERVE_MAX_WORKERS) nthreads = SERVE_MAX_WORKERS;
+    ServeJob job = { fn, ctx };
+    pool_run(nthreads, nthreads, serve_worker, &job);
+
+    serve_listen_fd = -1;
+    close(fd);
+    unlink(path);
+    return 0;
+}
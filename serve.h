@@ -0,0 +1,44 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stddef.h>
+
+/* Line-oriented request server on a Unix domain socket. Requests are read
+ * against an immutable "view" published by the application; publishing a
+ * new view swaps a pointer and never blocks the readers (RCU style: the
+ * old view is handed back once no request can still be reading it). */
+
+/* Reply being assembled for one connection. Replies to pipelined requests
+ * are sent together once every buffered request line has been answered. */
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    int error;
+} ServeOut;
+
+void serve_out(ServeOut *o, const char *s, size_t n);
+void serve_out_str(ServeOut *o, const char *s);
+
+/* Answer one request line (without its newline) from view. Runs on the
+ * worker threads, concurrently with other calls. */
+typedef void (*ServeHandlerFn)(const void *view, const char *line, size_t len, ServeOut *out, void *ctx);
+
+/* Make view the one new requests see. Returns the previous view once no
+ * request is still reading it, for the caller to free. May be called from
+ * a handler (the request calling it must not touch its own view afterwards)
+ * or before serve_run(). Calls must not overlap. */
+void *serve_publish(void *view);
+
+/* Called from a handler that is done with its view and will not read it
+ * again: publishers stop waiting for this request. A handler must call it
+ * before it can block on anything a publisher may hold, or a publisher
+ * waiting for this request and this request waiting for the publisher
+ * deadlock. */
+void serve_release(void);
+
+/* Listen on path (replacing a stale socket file) and answer requests on
+ * nthreads worker threads until SIGINT or SIGTERM. Returns 0, or -1 if the
+ * socket cannot be set up (errno set). */
+int serve_run(const char *path, int nthreads, ServeHandlerFn fn, void *ctx);
+
+#endif /* SERVE_H */
@@ -0,0 +1,44 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Probes behind the Summary Report's per-phase instrumentation */
+
+/* Heap allocations made through stats_malloc, stats_calloc and
+ * stats_realloc, from any thread. Code whose allocations belong in the
+ * Summary Report calls these by name; stats_free is their counterpart. */
+extern atomic_uint_least64_t stats_allocs;
+
+static inline void *stats_malloc(size_t n) {
+    atomic_fetch_add_explicit(&stats_allocs, 1, memory_order_relaxed);
+    return malloc(n);
+}
+static inline void *stats_calloc(size_t n, size_t size) {
+    atomic_fetch_add_explicit(&stats_allocs, 1, memory_order_relaxed);
+    return calloc(n, size);
+}
+static inline void *stats_realloc(void *p, size_t n) {
+    atomic_fetch_add_explicit(&stats_allocs, 1, memory_order_relaxed);
+    return realloc(p, n);
+}
+static inline void stats_free(void *p) {
+    free(p);
+}
+
+/* Monotonic clock in seconds */
+double stats_now(void);
+
+/* Start a fresh peak-memory window. Returns 1 if the kernel supports
+ * resetting the peak (Linux), 0 if stats_peak_kb() will report the
+ * process-lifetime peak instead. */
+int stats_peak_reset(void);
+
+/* Peak resident set size in KiB since the last reset (or process start),
+ * or -1 if unknown */
+long stats_peak_kb(void);
+
+#endif /* STATS_H */
@@ -0,0 +1,95 @@
+#include "strpool.h"
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+static uint32_t hash_bytes(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int strpool_reserve(StrPool *sp, size_t extra) {
+    if (sp->len + extra <= sp->cap) return 0;
+    size_t want = sp->cap ? sp->cap : 4096;
+    while (want < sp->len + extra) want *= 2;
+    if (want > (size_t)UINT32_MAX) {
+        if (sp->len + extra > (size_t)UINT32_MAX) return -1;
+        want = UINT32_MAX;
+    }
+    char *tmp = stats_realloc(sp->buf, want);
+    if (!tmp) return -1;
+    sp->buf = tmp;
+    sp->cap = want;
+    return 0;
+}
+
+uint32_t strpool_add(StrPool *sp, const char *s, size_t n) {
+    if (strpool_reserve(sp, n + 1) != 0) return STRPOOL_NONE;
+    uint32_t off = (uint32_t)sp->len;
+    memcpy(sp->buf + off, s, n);
+    sp->buf[off + n] = '\0';
+    sp->len += n + 1;
+    return off;
+}
+
+static int intern_grow(StrPool *sp) {
+    uint32_t ncap = sp->table_cap ? sp->table_cap * 2 : 256;
+    uint32_t *nt = stats_calloc(ncap, sizeof(uint32_t));
+    if (!nt) return -1;
+    for (uint32_t i = 0; i < sp->table_cap; ++i) {
+        uint32_t e = sp->table[i];
+        if (!e) continue;
+        const char *s = sp->buf + (e - 1);
+        uint32_t pos = hash_bytes(s, strlen(s)) & (ncap - 1);
+        while (nt[pos]) pos = (pos + 1) & (ncap - 1);
+        nt[pos] = e;
+    }
+    stats_free(sp->table);
+    sp->table = nt;
+    sp->table_cap = ncap;
+    return 0;
+}
+
+uint32_t strpool_intern(StrPool *sp, const char *s, size_t n) {
+    if ((sp->interned + 1) * 2 > sp->table_cap && intern_grow(sp) != 0) return STRPOOL_NONE;
+    uint32_t mask = sp->table_cap - 1;
+    uint32_t pos = hash_bytes(s, n) & mask;
+    for (; sp->table[pos]; pos = (pos + 1) & mask) {
+        const char *e = sp->buf + (sp->table[pos] - 1);
+        if (strncmp(e, s, n) == 0 && e[n] == '\0') return sp->table[pos] - 1;
+    }
+    uint32_t off = strpool_add(sp, s, n);
+    if (off == STRPOOL_NONE) return off;
+    sp->table[pos] = off + 1;
+    sp->interned++;
+    return off;
+}
+
+int strpool_register(StrPool *sp, uint32_t off) {
+    if ((sp->interned + 1) * 2 > sp->table_cap && intern_grow(sp) != 0) return -1;
+    const char *s = sp->buf + off;
+    uint32_t mask = sp->table_cap - 1;
+    uint32_t pos = hash_bytes(s, strlen(s)) & mask;
+    for (; sp->table[pos]; pos = (pos + 1) & mask) {
+        if (strcmp(sp->buf + (sp->table[pos] - 1), s) == 0) return 0;
+    }
+    sp->table[pos] = off + 1;
+    sp->interned++;
+    return 0;
+}
+
+void strpool_clear(StrPool *sp) {
+    sp->len = 0;
+    if (sp->table) memset(sp->table, 0, sizeof(uint32_t) * sp->table_cap);
+    sp->interned = 0;
+}
+
+void strpool_free(StrPool *sp) {
+    stats_free(sp->buf);
+    stats_free(sp->table);
+    memset(sp, 0, sizeof *sp);
+}
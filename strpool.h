@@ -0,0 +1,40 @@
+#ifndef STRPOOL_H
+#define STRPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Append-only string arena. Strings are stored NUL-terminated in one
+ * contiguous buffer and referred to by 32-bit offsets, which stay valid
+ * when the buffer grows (pointers from strpool_get do not). */
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    uint32_t *table;     /* intern table: offset + 1, 0 = empty */
+    uint32_t table_cap;  /* power of two, or 0 */
+    uint32_t interned;
+} StrPool;
+
+#define STRPOOL_NONE UINT32_MAX
+
+static inline const char *strpool_get(const StrPool *sp, uint32_t off) { return sp->buf + off; }
+
+/* Make room for at least extra more bytes. Returns 0, or -1 on memory error. */
+int strpool_reserve(StrPool *sp, size_t extra);
+
+/* Copy s[0..n) into the pool. Returns its offset, or STRPOOL_NONE on error. */
+uint32_t strpool_add(StrPool *sp, const char *s, size_t n);
+
+/* Like strpool_add, but returns the existing offset when an equal string
+ * was interned before, so repeated values are stored once. */
+uint32_t strpool_intern(StrPool *sp, const char *s, size_t n);
+
+/* Enter a string already stored at off into the intern table, e.g. after
+ * the buffer was restored wholesale. Returns 0, or -1 on memory error. */
+int strpool_register(StrPool *sp, uint32_t off);
+
+/* Drop every string but keep the buffers for reuse */
+void strpool_clear(StrPool *sp);
+void strpool_free(StrPool *sp);
+
+#endif /* STRPOOL_H */
@@ -0,0 +1,139 @@
+#!/bin/sh
+# Behaviour checks for srms, run by `make check`:
+#
+#   check.sh OUT_DIR
+#
+# SRMS and GEN name the srms binary and the roster generator (bench/gen).
+# Each check works in its own directory under OUT_DIR and prints PASS or
+# FAIL lines; the exit status is the number of failures.
+
+OUT=${1:-tests/out}
+SRMS=${SRMS:-$PWD/srms}
+GEN=${GEN:-$PWD/bench/gen}
+failures=0
+
+pass() { echo "PASS: $*"; }
+fail() { echo "FAIL: $*"; failures=$((failures + 1)); }
+
+# expect DESCRIPTION COMMAND...: the command must succeed
+expect() {
+    what=$1; shift
+    if "$@"; then pass "$what"; else fail "$what"; fi
+}
+
+fresh() {
+    rm -rf "$OUT/$1" && mkdir -p "$OUT/$1" && cd "$OUT/$1" || exit 1
+}
+
+# Field $2 of the CSV row whose SAP is $1, in file $3
+field() {
+    awk -F, -v sap="$1" -v col="$2" '$1 == sap { print $col; exit }' "$3"
+}
+
+# No batch holds more than its capacity and, with a third argument,
+# course-tagged batches only hold their course. $1 student CSV with
+# allocated_batch, $2 batch spec. Names must not hold commas.
+check_seats() {
+    awk -F, -v by_course="${3:-}" '
+        NR == FNR { if (FNR > 1) { cap[FNR - 2] = $2; course[FNR - 2] = $3 } next }
+        FNR == 1 { next }
+        $5 >= 0 {
+            filled[$5]++
+            if (by_course != "" && course[$5] != "" && course[$5] != $4) { print "course mismatch: " $0; bad = 1 }
+        }
+        END {
+            for (b in filled) if (filled[b] > cap[b]) { print "batch " b " over capacity"; bad = 1 }
+            exit bad
+        }' "$2" "$1"
+}
+
+seated() { awk -F, 'NR > 1 && $5 >= 0 { n++ } END { print n + 0 }' "$1"; }
+rows() { awk 'NR > 1 { n++ } END { print n + 0 }' "$1"; }
+capacity() { awk -F, 'NR > 1 { n += $2 } END { print n + 0 }' "$1"; }
+
+mkdir -p "$OUT" || exit 1
+OUT=$(cd "$OUT" && pwd)
+
+# ---- CSV -> snapshot -> CSV round trip ----
+# 100000 rows are loaded in parallel chunks; quoted names and a duplicate
+# SAP ride along at the end.
+fresh roundtrip
+"$GEN" 100000 500 r >/dev/null || exit 1
+cat >>r.students.csv <<'EOF'
+400000001,"Rao, Asha",88.50,CSE,
+400000002,"Asha ""AR"" Rao",77.25,ECE,
+400000001,Duplicate,10.00,ME,
+EOF
+"$SRMS" allocate --in r.students.csv --batches r.batches.csv --strategy marks \
+    --out a.csv --snapshot-out a.snap 2>err.txt
+expect "round trip: allocate and save" test -s a.csv -a -s a.snap
+"$SRMS" allocate --snapshot-in a.snap --out b.csv 2>>err.txt
+expect "round trip: snapshot reloads to the same CSV" cmp -s a.csv b.csv
+"$SRMS" allocate --in a.csv --out c.csv 2>>err.txt
+expect "round trip: saved CSV and its batches reload to the same CSV" cmp -s a.csv c.csv
+expect "round trip: every distinct SAP kept" test "$(rows a.csv)" -eq 100002
+expect "round trip: the first duplicate row wins" grep -q '^400000001,"Rao, Asha",88.50,CSE,' a.csv
+expect "round trip: quotes survive" grep -q '^400000002,"Asha ""AR"" Rao",77.25,ECE,' a.csv
+
+# ---- journal replay after a torn write ----
+fresh journal
+printf 'sap,name,marks,course\n1,A,90,CSE\n2,B,80,ECE\n3,C,70,CSE\n' >students.csv
+# delete 1 and 2, then cut the journal inside the record deleting 2
+printf '\n2\n4\n1\n4\n2\n18\n3\n\n' | "$SRMS" >run1.txt 2>&1
+size=$(wc -c <srms.journal)
+head -c $((size - 3)) srms.journal >torn && mv torn srms.journal
+printf '\n2\n8\nout1.csv\n4\n3\n18\n3\n\n' | "$SRMS" >run2.txt 2>&1
+printf 'sap,name,marks,course,allocated_batch\n2,B,80.00,ECE,-1\n3,C,70.00,CSE,-1\n' >want1.csv
+expect "journal: torn record dropped, earlier edits replayed" cmp -s out1.csv want1.csv
+printf '\n2\n8\nout2.csv\n18\n3\n\n' | "$SRMS" >run3.txt 2>&1
+printf 'sap,name,marks,course,allocated_batch\n2,B,80.00,ECE,-1\n' >want2.csv
+expect "journal: edits after the recovery replay too" cmp -s out2.csv want2.csv
+
+# ---- allocation invariants ----
+fresh alloc
+"$GEN" 20000 100 r >/dev/null || exit 1
+for s in marks az random balanced prefs; do
+    "$SRMS" allocate --in r.students.csv --batches r.batches.csv --prefs r.prefs.csv \
+        --strategy $s --by-course --out $s.csv 2>>err.txt
+    expect "alloc $s by course: capacity and courses respected" check_seats $s.csv r.batches.csv by-course
+done
+for p in round-robin proportional; do
+    "$SRMS" allocate --in r.students.csv --batches r.batches.csv --strategy marks \
+        --placement $p --out $p.csv 2>>err.txt
+    expect "alloc $p: capacity respected, everyone seated" \
+        test "$(check_seats $p.csv r.batches.csv >/dev/null && seated $p.csv)" = "$(rows $p.csv)"
+done
+# with half the seats the preference flow still fills every one of them
+awk -F, 'BEGIN { OFS = "," } NR > 1 { $2 = int($2 / 2) } { print }' r.batches.csv >half.csv
+"$SRMS" allocate --in r.students.csv --batches half.csv --prefs r.prefs.csv \
+    --strategy prefs --out prefs-half.csv 2>>err.txt
+expect "alloc prefs: every seat capacity allows is filled" \
+    test "$(check_seats prefs-half.csv half.csv >/dev/null && seated prefs-half.csv)" = "$(capacity half.csv)"
+
+# ---- merge policies ----
+fresh merge
+printf 'sap,name,marks,course\n1,A,90,CSE\n2,B,80,ECE\n3,C,70,CSE\n' >base.csv
+printf 'name,capacity,course\nC1,2,CSE\nE1,2,ECE\n' >b.csv
+printf 'sap,name,marks,course\n1,A,90,ECE\n2,Bee,85,ECE\n4,D,60,ECE\n' >m.csv
+"$SRMS" allocate --in base.csv --batches b.csv --by-course --strategy marks --out seated.csv \
+    --snapshot-out seated.snap 2>>err.txt
+"$SRMS" allocate --snapshot-in seated.snap --merge m.csv --merge-report keep.txt --out keep.csv 2>>err.txt
+expect "merge keep: existing record kept" test "$(field 2 2 keep.csv),$(field 2 3 keep.csv)" = "B,80.00"
+expect "merge keep: new SAP added unallocated" test "$(field 4 5 keep.csv)" = "-1"
+"$SRMS" allocate --snapshot-in seated.snap --merge m.csv --on-duplicate overwrite \
+    --merge-report over.txt --out over.csv 2>>err.txt
+expect "merge overwrite: incoming row taken" test "$(field 2 2 over.csv),$(field 2 3 over.csv)" = "Bee,85.00"
+expect "merge overwrite: seat kept when the course is unchanged" test "$(field 2 5 over.csv)" = "$(field 2 5 seated.csv)"
+expect "merge overwrite: course change leaves the CSE batch" test "$(field 1 4 over.csv),$(field 1 5 over.csv)" = "ECE,-1"
+expect "merge overwrite: report counts" \
+    awk '$1 == "m.csv" && $2 == 3 && $3 == 1 && $4 == 0 && $5 == 2 && $6 == 0 && $7 == 1 { ok = 1 } END { exit !ok }' over.txt
+touch -t 200001010000 m.csv
+touch base.csv
+"$SRMS" allocate --in base.csv --merge m.csv --on-duplicate newest --out old.csv 2>>err.txt
+expect "merge newest: an older file loses" test "$(field 2 2 old.csv)" = "B"
+touch -t 203001010000 m.csv
+"$SRMS" allocate --in base.csv --merge m.csv --on-duplicate newest --out new.csv 2>>err.txt
+expect "merge newest: a newer file wins" test "$(field 2 2 new.csv)" = "Bee"
+
+echo "$failures failure(s)"
+exit $failures